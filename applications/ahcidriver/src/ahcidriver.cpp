@@ -206,19 +206,22 @@ bool ahciReadDMA(g_ahci_device* ahciDevice,
 	if(slot == -1)
 		return false;
 
+	// A single PRDT entry can describe up to 4 MiB, which is also the largest contiguous block
 	size_t bytes = (size_t) sectorCount * 512;
-	if(bytes > G_PAGE_SIZE)
+	if(bytes > 0x400000)
 	{
-		// TODO
-		klog("TODO: FAILED TO READ DMA - no contiugous physical alloc implemneted");
+		klog("can't read more than 4 MiB with one DMA transfer");
 		return false;
 	}
 
 	size_t alloc_size = ((bytes + G_PAGE_SIZE - 1) / G_PAGE_SIZE) * G_PAGE_SIZE;
-	void* data_phys;
-	void* data_virt = g_alloc_mem_p(alloc_size, &data_phys);
-	if(!data_phys)
+	void* data_phys = nullptr;
+	void* data_virt = g_alloc_mem_contiguous(alloc_size, G_PAGE_SIZE, G_MEM_CONTIGUOUS_BELOW_4G, &data_phys);
+	if(!data_virt)
+	{
+		klog("failed to allocate contiguous buffer for DMA transfer");
 		return false;
+	}
 	memset(data_virt, 0, alloc_size);
 
 	void* cmdTablePhys;
@@ -226,6 +229,9 @@ bool ahciReadDMA(g_ahci_device* ahciDevice,
 	if(!cmdTablePhys)
 	{
 		klog("failed to allocate buffer for cmd table");
+		if(cmdTable)
+			g_unmap(cmdTable);
+		g_unmap(data_virt);
 		return false;
 	}
 	memset(cmdTable, 0, G_PAGE_SIZE);
@@ -275,10 +281,13 @@ bool ahciReadDMA(g_ahci_device* ahciDevice,
 		if(ahciDevice->port->is & (1 << 30))
 		{
 			klog("ahci: task file error on port");
+			g_unmap(cmdTable);
+			g_unmap(data_virt);
 			return false;
 		}
 		g_sleep(1);
 	}
+	g_unmap(cmdTable);
 
 	if(outVirt)
 		*outVirt = data_virt;
@@ -73,6 +73,7 @@ int procListCompareByParent(const void* a, const void* b)
 
 
 std::unordered_map<g_tid, uint64_t> lastCpuTimes;
+uint64_t lastListTime = 0;
 
 /**
  *
@@ -111,13 +112,18 @@ int procList(int argc, char** argv, bool top)
 	qsort(taskData, taskCount, sizeof(g_kernquery_task_get_data), procListCompareByParent);
 
 	// print information
+	uint64_t elapsedNanos = 0;
 	if(top)
 	{
 		g_terminal::clear();
 		g_terminal::setCursor(g_term_cursor_position(0, 0));
+
+		uint64_t now = g_millis();
+		elapsedNanos = (now - lastListTime) * 1000000;
+		lastListTime = now;
 	}
 
-	println("%4s %4s %-20s %-38s %5s %5s", "pid", "tid", "id", "path", "mem", top ? "cpu" : "");
+	println("%4s %4s %-20s %-38s %5s %5s", "pid", "tid", "id", "path", "mem", top ? "cpu%" : "");
 	for(uint32_t pos = 0; pos < taskCount; pos++)
 	{
 		g_kernquery_task_get_data* entry = &taskData[pos];
@@ -127,8 +133,11 @@ int procList(int argc, char** argv, bool top)
 		{
 			if(top)
 			{
-				uint64_t cpuTimeTaken = entry->cpu_time - lastCpuTimes[entry->id];
-				lastCpuTimes[entry->id] = entry->cpu_time;;
+				// Without threads, each line stands for the whole process
+				uint64_t cpuTime = threads ? entry->cpu_time : entry->process_cpu_time;
+				uint64_t cpuTimeTaken = cpuTime - lastCpuTimes[entry->id];
+				lastCpuTimes[entry->id] = cpuTime;
+				uint64_t cpuPercent = elapsedNanos ? cpuTimeTaken * 100 / elapsedNanos : 0;
 
 				println("%4i %4i %-20s %-38s %5i %5i",
 				        entry->parent,
@@ -136,7 +145,7 @@ int procList(int argc, char** argv, bool top)
 				        entry->identifier,
 				        entry->source_path,
 				        entry->memory_used / 1024,
-				        cpuTimeTaken / 1000000);
+				        cpuPercent);
 			}
 			else
 			{
@@ -0,0 +1,81 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                                                                           *
+ *  Ghost, a micro-kernel based operating system for the x86 architecture    *
+ *  Copyright (C) 2015, Max Schlüssel <lokoxe@gmail.com>                     *
+ *                                                                           *
+ *  This program is free software: you can redistribute it and/or modify     *
+ *  it under the terms of the GNU General Public License as published by     *
+ *  the Free Software Foundation, either version 3 of the License, or        *
+ *  (at your option) any later version.                                      *
+ *                                                                           *
+ *  This program is distributed in the hope that it will be useful,          *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of           *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the            *
+ *  GNU General Public License for more details.                             *
+ *                                                                           *
+ *  You should have received a copy of the GNU General Public License        *
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.    *
+ *                                                                           *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "locks.hpp"
+
+#include <ghost.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+int procLocksCompareByWaitTime(const void* a, const void* b)
+{
+	g_kernquery_lock_get_data* dataA = ((g_kernquery_lock_get_data*) a);
+	g_kernquery_lock_get_data* dataB = ((g_kernquery_lock_get_data*) b);
+
+	if(dataA->wait_time == dataB->wait_time)
+		return 0;
+	else if(dataA->wait_time > dataB->wait_time)
+		return -1;
+	else
+		return 1;
+}
+
+/**
+ *
+ */
+int procLocks(int argc, char** argv)
+{
+	g_kernquery_lock_count_data count;
+	g_kernquery_status countstatus = g_kernquery(G_KERNQUERY_LOCK_COUNT, (uint8_t*) &count);
+	if(countstatus != G_KERNQUERY_STATUS_SUCCESSFUL)
+	{
+		fprintf(stderr, "kernel lock statistics are not available (code %i)\n", countstatus);
+		return -1;
+	}
+
+	g_kernquery_lock_get_data* lockData = new g_kernquery_lock_get_data[count.count];
+	uint32_t filled = 0;
+	for(uint32_t i = 0; i < count.count; i++)
+	{
+		lockData[filled].index = i;
+		g_kernquery_status getstatus = g_kernquery(G_KERNQUERY_LOCK_GET, (uint8_t*) &lockData[filled]);
+		if(getstatus == G_KERNQUERY_STATUS_SUCCESSFUL)
+			++filled;
+	}
+
+	qsort(lockData, filled, sizeof(g_kernquery_lock_get_data), procLocksCompareByWaitTime);
+
+	println("%-32s %-6s %10s %10s %10s %10s %10s", "location", "type", "acquired", "contended", "wait us", "max wait", "max hold");
+	for(uint32_t pos = 0; pos < filled; pos++)
+	{
+		g_kernquery_lock_get_data* entry = &lockData[pos];
+		println("%-32s %-6s %10llu %10llu %10llu %10llu %10llu",
+		        entry->location,
+		        entry->global ? "global" : "task",
+		        entry->acquisitions,
+		        entry->contended,
+		        entry->wait_time / 1000,
+		        entry->wait_max / 1000,
+		        entry->hold_max / 1000);
+	}
+
+	delete[] lockData;
+	return 0;
+}
@@ -27,6 +27,7 @@
 #define PATCH 1
 
 #include "list/list.hpp"
+#include "locks/locks.hpp"
 
 /**
  *
@@ -50,6 +51,10 @@ int main(int argc, char** argv)
 				g_sleep(1000);
 			}
 		}
+		else if(strcmp(command, "--locks") == 0)
+		{
+			return procLocks(argc, argv);
+		}
 		else if(strcmp(command, "-k") == 0 || strcmp(command, "--kill") == 0)
 		{
 			if(argc > 2)
@@ -92,6 +97,7 @@ int main(int argc, char** argv)
 			println("");
 			println("\t-l\t\tlists running tasks");
 			println("\t-k <id>\tkills a process");
+			println("\t--locks\tkernel lock contention statistics");
 			println("");
 		}
 		else
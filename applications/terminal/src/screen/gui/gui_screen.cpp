@@ -34,8 +34,7 @@ bool gui_screen_t::initialize(g_user_mutex exitFlag)
 {
 	this->exitFlag = exitFlag;
 	inputBufferLock = g_mutex_initialize();
-	inputBufferEmpty = g_mutex_initialize();
-	g_mutex_acquire(inputBufferEmpty);
+	g_condition_initialize(&inputAvailable);
 
 	if(!createUi())
 		return false;
@@ -139,25 +138,13 @@ void canvas_resize_bounds_listener_t::handleBoundsChanged(Rectangle bounds)
 
 g_key_info gui_screen_t::readInput()
 {
-	g_key_info result;
-
-	for(;;)
-	{
-		g_mutex_acquire(inputBufferLock);
-		if(inputBuffer.size() == 0)
-		{
-			g_mutex_release(inputBufferLock);
-			g_mutex_acquire(inputBufferEmpty);
-		}
-		else
-		{
-			result = inputBuffer.front();
-			inputBuffer.pop_front();
-			g_mutex_release(inputBufferLock);
-			break;
-		}
-	}
+	g_mutex_acquire(inputBufferLock);
+	while(inputBuffer.size() == 0)
+		g_condition_wait(&inputAvailable, inputBufferLock);
 
+	g_key_info result = inputBuffer.front();
+	inputBuffer.pop_front();
+	g_mutex_release(inputBufferLock);
 	return result;
 }
 
@@ -166,9 +153,8 @@ void gui_screen_t::bufferInput(const g_key_info& info)
 	g_mutex_acquire(inputBufferLock);
 	inputBuffer.push_back(info);
 	lastInputTime = g_millis();
-	g_mutex_release(inputBufferEmpty);
+	g_condition_signal(&inputAvailable);
 	g_mutex_release(inputBufferLock);
-	g_yield();
 }
 
 void canvas_buffer_listener_t::handleBufferChanged()
@@ -49,7 +49,7 @@ class gui_screen_t : public screen_t
     Window* window;
 
     std::list<g_key_info> inputBuffer;
-    g_user_mutex inputBufferEmpty;
+    g_user_condition inputAvailable;
     g_user_mutex inputBufferLock;
 
     bool fullRepaint;
@@ -0,0 +1,87 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                                                                           *
+ *  Ghost, a micro-kernel based operating system for the x86 architecture    *
+ *  Copyright (C) 2015, Max Schlüssel <lokoxe@gmail.com>                     *
+ *                                                                           *
+ *  This program is free software: you can redistribute it and/or modify     *
+ *  it under the terms of the GNU General Public License as published by     *
+ *  the Free Software Foundation, either version 3 of the License, or        *
+ *  (at your option) any later version.                                      *
+ *                                                                           *
+ *  This program is distributed in the hope that it will be useful,          *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of           *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the            *
+ *  GNU General Public License for more details.                             *
+ *                                                                           *
+ *  You should have received a copy of the GNU General Public License        *
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.    *
+ *                                                                           *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "tester.hpp"
+
+#define PIPE_TEST_WRITERS	4
+#define PIPE_TEST_READERS	4
+#define PIPE_TEST_BYTES		20000
+
+static g_fd pipeTestWrite;
+static g_fd pipeTestRead;
+static volatile int pipeTestReceived[PIPE_TEST_WRITERS];
+static volatile int pipeTestEnded;
+
+/**
+ * Writes single bytes that identify the writer, so that readers can check
+ * that nothing got lost or duplicated.
+ */
+static void pipeTestWriter(void* data)
+{
+	uint8_t value = (uint8_t) (uintptr_t) data;
+	for(int i = 0; i < PIPE_TEST_BYTES; i++)
+	{
+		if(g_write(pipeTestWrite, &value, 1) != 1)
+		{
+			klog("pipe test writer %i failed to write", value);
+			return;
+		}
+	}
+}
+
+static void pipeTestReader()
+{
+	uint8_t value;
+	while(g_read(pipeTestRead, &value, 1) == 1)
+	{
+		if(value < PIPE_TEST_WRITERS)
+			__sync_fetch_and_add(&pipeTestReceived[value], 1);
+	}
+	__sync_fetch_and_add(&pipeTestEnded, 1);
+}
+
+test_result_t runPipeTest()
+{
+	ASSERT(g_pipe(&pipeTestWrite, &pipeTestRead) == G_FS_PIPE_SUCCESSFUL);
+
+	// Readers and writers block on the same pipe concurrently
+	g_tid readers[PIPE_TEST_READERS];
+	for(int i = 0; i < PIPE_TEST_READERS; i++)
+		readers[i] = g_create_task((void*) &pipeTestReader);
+
+	g_tid writers[PIPE_TEST_WRITERS];
+	for(int i = 0; i < PIPE_TEST_WRITERS; i++)
+		writers[i] = g_create_task_d((void*) &pipeTestWriter, (void*) (uintptr_t) i);
+
+	for(int i = 0; i < PIPE_TEST_WRITERS; i++)
+		g_join(writers[i]);
+
+	// Closing the last write end lets the readers see the end of the pipe
+	g_close(pipeTestWrite);
+	for(int i = 0; i < PIPE_TEST_READERS; i++)
+		g_join(readers[i]);
+	g_close(pipeTestRead);
+
+	ASSERT(pipeTestEnded == PIPE_TEST_READERS);
+	for(int i = 0; i < PIPE_TEST_WRITERS; i++)
+		ASSERT(pipeTestReceived[i] == PIPE_TEST_BYTES);
+
+	TEST_SUCCESSFUL;
+}
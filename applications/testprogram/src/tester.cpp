@@ -24,6 +24,7 @@
 #include <libfenster/components/window.hpp>
 #include <libfenster/components/panel.hpp>
 #include <cstdio>
+#include <cstring>
 #include <libfenster/components/checkbox.hpp>
 #include <libfenster/components/label.hpp>
 #include <libfenster/components/text_box.hpp>
@@ -32,6 +33,13 @@
 
 int main(int argc, char** argv)
 {
+	// Stress tests run without the UI
+	if(argc > 1 && strcmp(argv[1], "--pipe-test") == 0)
+	{
+		test_result_t result = runPipeTest();
+		return result.failed ? -1 : 0;
+	}
+
 	if(fenster::Application::open() != fenster::ApplicationOpenStatus::Success)
 	{
 		printf("Failed to start UI\n");
@@ -62,3 +62,5 @@ test_result_t runMessageTest();
 test_result_t runStdioTest();
 
 test_result_t runThreadTests();
+
+test_result_t runPipeTest();
@@ -42,6 +42,9 @@
 #define G_DEBUG_WHOS_WAITING false
 #define G_DEBUG_THREAD_DUMPING false
 
+// per-lock contention statistics, queryable with kernquery
+#define G_DEBUG_LOCK_STATISTICS false
+
 // mode for the debug interface
 #define G_DEBUG_INTERFACE_MODE G_DEBUG_INTERFACE_MODE_PLAIN_LOG
 
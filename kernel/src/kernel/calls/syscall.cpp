@@ -90,7 +90,7 @@ void syscallRegisterAll()
 	_syscallRegister(G_SYSCALL_GET_PROCESS_ID, (g_syscall_handler) syscallGetProcessId);
 	_syscallRegister(G_SYSCALL_GET_TASK_ID, (g_syscall_handler) syscallGetTaskId);
 	_syscallRegister(G_SYSCALL_GET_PROCESS_ID_FOR_TASK_ID, (g_syscall_handler) syscallGetProcessIdForTaskId);
-	_syscallRegister(G_SYSCALL_FORK, (g_syscall_handler) syscallFork);
+	_syscallRegister(G_SYSCALL_FORK, (g_syscall_handler) syscallFork, true);
 	_syscallRegister(G_SYSCALL_JOIN, (g_syscall_handler) syscallJoin);
 	_syscallRegister(G_SYSCALL_SLEEP, (g_syscall_handler) syscallSleep);
 	_syscallRegister(G_SYSCALL_RELEASE_CLI_ARGUMENTS, (g_syscall_handler) syscallReleaseCliArguments);
@@ -111,6 +111,7 @@ void syscallRegisterAll()
 	_syscallRegister(G_SYSCALL_DUMP, (g_syscall_handler) syscallDump);
 	_syscallRegister(G_SYSCALL_GET_NANOSECONDS, (g_syscall_handler) syscallGetNanoseconds);
 	_syscallRegister(G_SYSCALL_TASK_AWAIT_BY_NAME, (g_syscall_handler) syscallTaskAwaitByName);
+	_syscallRegister(G_SYSCALL_TASK_SET_PRIORITY, (g_syscall_handler) syscallTaskSetPriority);
 
 	// Memory
 	_syscallRegister(G_SYSCALL_LOWER_MEMORY_ALLOCATE, (g_syscall_handler) syscallLowerMemoryAllocate, true);
@@ -120,12 +121,11 @@ void syscallRegisterAll()
 	_syscallRegister(G_SYSCALL_SHARE_MEMORY, (g_syscall_handler) syscallShareMemory, true);
 	_syscallRegister(G_SYSCALL_MAP_MMIO_AREA, (g_syscall_handler) syscallMapMmioArea, true);
 	_syscallRegister(G_SYSCALL_SBRK, (g_syscall_handler) syscallSbrk, true);
+	_syscallRegister(G_SYSCALL_ALLOCATE_MEMORY_CONTIGUOUS, (g_syscall_handler) syscallAllocateMemoryContiguous, true);
 
 	// Mutex
-	_syscallRegister(G_SYSCALL_USER_MUTEX_INITIALIZE, (g_syscall_handler) syscallMutexInitialize);
-	_syscallRegister(G_SYSCALL_USER_MUTEX_ACQUIRE, (g_syscall_handler) sycallMutexAcquire);
-	_syscallRegister(G_SYSCALL_USER_MUTEX_RELEASE, (g_syscall_handler) syscallMutexRelease);
-	_syscallRegister(G_SYSCALL_USER_MUTEX_DESTROY, (g_syscall_handler) syscallMutexDestroy);
+	_syscallRegister(G_SYSCALL_USER_MUTEX_WAIT, (g_syscall_handler) syscallMutexWait);
+	_syscallRegister(G_SYSCALL_USER_MUTEX_WAKE, (g_syscall_handler) syscallMutexWake);
 
 	// Messages
 	_syscallRegister(G_SYSCALL_MESSAGE_SEND, (g_syscall_handler) syscallMessageSend);
@@ -19,6 +19,8 @@
  * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
 
 #include "kernel/calls/syscall_kernquery.hpp"
+#include "kernel/memory/memory.hpp"
+#include "kernel/system/mutex.hpp"
 #include "kernel/tasking/clock.hpp"
 #include "kernel/tasking/tasking_directory.hpp"
 #include "kernel/utils/hashmap.hpp"
@@ -53,9 +55,16 @@ void syscallKernQuery(g_task* task, g_syscall_kernquery* data)
 		auto out = (g_kernquery_task_get_data*) data->buffer;
 
 		g_task* target = taskingGetById(out->id);
+		if(!target)
+		{
+			data->status = G_KERNQUERY_STATUS_UNKNOWN_ID;
+			out->id = -1;
+			return;
+		}
+
 		mutexAcquire(&target->lock);
 
-		if(!target || target->status == G_TASK_STATUS_DEAD)
+		if(target->status == G_TASK_STATUS_DEAD)
 		{
 			data->status = G_KERNQUERY_STATUS_UNKNOWN_ID;
 			out->id = -1;
@@ -79,11 +88,65 @@ void syscallKernQuery(g_task* task, g_syscall_kernquery* data)
 			else
 				out->identifier[0] = 0;
 
-			out->cpu_time = target->statistics.timesScheduled;
-			out->memory_used = 0; // TODO
+			out->user_time = clockTscToNanos(target->statistics.userTime);
+			out->kernel_time = clockTscToNanos(target->statistics.kernelTime);
+			out->wait_time = clockTscToNanos(target->statistics.waitTime);
+			out->cpu_time = out->user_time + out->kernel_time;
 		}
 
 		mutexRelease(&target->lock);
+
+		if(data->status == G_KERNQUERY_STATUS_SUCCESSFUL)
+		{
+			g_process* process = target->process;
+			mutexAcquire(&process->lock);
+
+			uint64_t processTime = process->statistics.userTime + process->statistics.kernelTime;
+			for(g_task_entry* entry = process->tasks; entry; entry = entry->next)
+				processTime += entry->task->statistics.userTime + entry->task->statistics.kernelTime;
+			out->process_cpu_time = clockTscToNanos(processTime);
+
+			out->memory_used = (process->image.end - process->image.start) + process->heap.pages * G_PAGE_SIZE;
+
+			mutexRelease(&process->lock);
+		}
+	}
+	else if(data->command == G_KERNQUERY_LOCK_COUNT)
+	{
+		auto out = (g_kernquery_lock_count_data*) data->buffer;
+
+		out->count = mutexStatisticsCount();
+		data->status = G_DEBUG_LOCK_STATISTICS ? G_KERNQUERY_STATUS_SUCCESSFUL : G_KERNQUERY_STATUS_ERROR;
+	}
+	else if(data->command == G_KERNQUERY_LOCK_GET)
+	{
+		auto out = (g_kernquery_lock_get_data*) data->buffer;
+
+		g_mutex_statistics statistics;
+		if(!mutexStatisticsGet(out->index, &statistics))
+		{
+			data->status = G_KERNQUERY_STATUS_UNKNOWN_ID;
+			out->found = false;
+			return;
+		}
+
+		data->status = G_KERNQUERY_STATUS_SUCCESSFUL;
+		out->found = true;
+
+		int length = stringLength(statistics.location);
+		if(length >= (int) sizeof(out->location))
+			length = sizeof(out->location) - 1;
+		memoryCopy(out->location, statistics.location, length);
+		out->location[length] = 0;
+		out->global = statistics.type == G_MUTEX_TYPE_GLOBAL;
+
+		out->acquisitions = statistics.acquisitions;
+		out->contended = statistics.contended;
+		out->spins = statistics.spins;
+		out->wait_time = clockTscToNanos(statistics.waitTime);
+		out->wait_max = clockTscToNanos(statistics.waitMax);
+		out->hold_time = clockTscToNanos(statistics.holdTime);
+		out->hold_max = clockTscToNanos(statistics.holdMax);
 	}
 	else
 	{
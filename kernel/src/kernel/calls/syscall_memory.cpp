@@ -19,6 +19,7 @@
  * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
 
 #include "kernel/calls/syscall_memory.hpp"
+#include "kernel/memory/contiguous_allocator.hpp"
 #include "kernel/memory/lower_heap.hpp"
 #include "kernel/memory/memory.hpp"
 #include "kernel/memory/page_reference_tracker.hpp"
@@ -74,13 +75,33 @@ void syscallAllocateMemory(g_task* task, g_syscall_alloc_mem* data)
 	bool failedPhysical = false;
 	for(uint32_t i = 0; i < pages; i++)
 	{
+		g_virtual_address virt = mapped + i * G_PAGE_SIZE;
+
+		// Parts of the range that cover a whole large page are mapped as one if possible
+		if(!(virt & G_PAGE_LARGE_ALIGN_MASK) && pages - i >= G_PAGE_LARGE_SIZE / G_PAGE_SIZE)
+		{
+			page = memoryPhysicalAllocateLarge();
+			if(page && pagingMapLargePage(virt, page, G_PAGE_TABLE_USER_DEFAULT, G_PAGE_USER_DEFAULT))
+			{
+				i += G_PAGE_LARGE_SIZE / G_PAGE_SIZE - 1;
+				continue;
+			}
+
+			// Fall back to mapping single pages
+			if(page)
+			{
+				for(g_physical_address part = page; part < page + G_PAGE_LARGE_SIZE; part += G_PAGE_SIZE)
+					memoryPhysicalFree(part);
+			}
+		}
+
 		page = memoryPhysicalAllocate();
 		if(!page)
 		{
 			failedPhysical = true;
 			break;
 		}
-		pagingMapPage(mapped + i * G_PAGE_SIZE, page, G_PAGE_TABLE_USER_DEFAULT,G_PAGE_TABLE_USER_DEFAULT,
+		pagingMapPage(virt, page, G_PAGE_TABLE_USER_DEFAULT,G_PAGE_TABLE_USER_DEFAULT,
 		              G_PAGE_TABLE_USER_DEFAULT, G_PAGE_USER_DEFAULT);
 	}
 
@@ -89,9 +110,23 @@ void syscallAllocateMemory(g_task* task, g_syscall_alloc_mem* data)
 		logInfo("%! ran out of physical memory during allocate-memory syscall in %i", "syscall", task->id);
 		for(uint32_t i = 0; i < pages; i++)
 		{
-			g_physical_address page = pagingVirtualToPhysical(mapped + i * G_PAGE_SIZE);
+			g_virtual_address virt = mapped + i * G_PAGE_SIZE;
+			g_physical_address page = pagingVirtualToPhysical(virt);
+			if(!page)
+				continue;
+
+			if(!(virt & G_PAGE_LARGE_ALIGN_MASK) && pagingUnmapLargePage(virt))
+			{
+				for(g_physical_address part = page; part < page + G_PAGE_LARGE_SIZE; part += G_PAGE_SIZE)
+					memoryPhysicalFree(part);
+				i += G_PAGE_LARGE_SIZE / G_PAGE_SIZE - 1;
+				continue;
+			}
+
 			memoryPhysicalFree(page);
+			pagingUnmapPage(virt);
 		}
+		interruptsSendTlbFlush(task->process->pageSpace);
 		addressRangePoolFree(task->process->virtualRangePool, mapped);
 		return;
 	}
@@ -100,12 +135,55 @@ void syscallAllocateMemory(g_task* task, g_syscall_alloc_mem* data)
 	data->physicalResult = (task->securityLevel <= G_SECURITY_LEVEL_DRIVER && pages == 1) ? (void*) page : nullptr;
 }
 
+void syscallAllocateMemoryContiguous(g_task* task, g_syscall_alloc_mem_contiguous* data)
+{
+	data->virtualResult = nullptr;
+	data->physicalResult = nullptr;
+
+	if(task->securityLevel > G_SECURITY_LEVEL_DRIVER)
+	{
+		logInfo("%! task %i is not allowed to allocate contiguous memory", "syscall", task->id);
+		return;
+	}
+
+	uint32_t pages = G_PAGE_ALIGN_UP(data->size) / G_PAGE_SIZE;
+	g_physical_address limit = (data->flags & G_MEM_CONTIGUOUS_BELOW_4G) ? 0x100000000ULL : 0;
+	g_physical_address block = contiguousAllocatorAllocate(pages, data->alignment, limit);
+	if(!block)
+	{
+		logInfo("%! task %i failed to allocate %i contiguous pages", "syscall", task->id, pages);
+		return;
+	}
+
+	g_virtual_address mapped = addressRangePoolAllocate(task->process->virtualRangePool, pages,
+	                                                     G_PROC_VIRTUAL_RANGE_FLAG_CONTIGUOUS);
+	if(mapped == 0)
+	{
+		logInfo("%! task %i failed to allocate a virtual address range for memory mapping", "syscall", task->id);
+		contiguousAllocatorFree(block);
+		return;
+	}
+
+	// Shared so that the block is not made copy-on-write when the driver forks
+	for(uint32_t i = 0; i < pages; i++)
+	{
+		g_physical_address page = block + i * G_PAGE_SIZE;
+		pagingMapPage(mapped + i * G_PAGE_SIZE, page, G_PAGE_TABLE_USER_DEFAULT,
+		              G_PAGE_USER_DEFAULT | G_PAGE_SHARED_FLAG);
+		pageReferenceTrackerIncrement(page);
+	}
+
+	data->virtualResult = (void*) mapped;
+	data->physicalResult = (void*) block;
+}
+
 void syscallUnmap(g_task* task, g_syscall_unmap* data)
 {
 	g_address_range* range = addressRangePoolFind(task->process->virtualRangePool, data->virtualBase);
 	if(!range)
 		return;
 
+	g_physical_address freeBlock = 0;
 	for(uint32_t i = 0; i < range->pages; i++)
 	{
 		g_virtual_address virt = range->base + i * G_PAGE_SIZE;
@@ -113,15 +191,74 @@ void syscallUnmap(g_task* task, g_syscall_unmap* data)
 		if(!page)
 			continue;
 
-		if((range->flags & G_PROC_VIRTUAL_RANGE_FLAG_WEAK) == 0)
+		// Large pages that lie completely within the range are removed without splitting,
+		// other processors must stop using them before the memory is freed
+		if(!(virt & G_PAGE_LARGE_ALIGN_MASK) && range->pages - i >= G_PAGE_LARGE_SIZE / G_PAGE_SIZE &&
+		   (range->flags & G_PROC_VIRTUAL_RANGE_FLAG_WEAK) == 0 && pagingUnmapLargePage(virt))
+		{
+			interruptsSendTlbFlush(task->process->pageSpace);
+			for(g_physical_address part = page; part < page + G_PAGE_LARGE_SIZE; part += G_PAGE_SIZE)
+				memoryPhysicalFree(part);
+			i += G_PAGE_LARGE_SIZE / G_PAGE_SIZE - 1;
+			continue;
+		}
+
+		if(range->flags & G_PROC_VIRTUAL_RANGE_FLAG_CONTIGUOUS)
+		{
+			// The block is freed as a whole once no process maps it anymore
+			if(pageReferenceTrackerDecrement(page) == 0 && i == 0)
+				freeBlock = page;
+		}
+		else if((range->flags & G_PROC_VIRTUAL_RANGE_FLAG_WEAK) == 0)
+		{
 			memoryPhysicalFree(page);
+		}
 
 		pagingUnmapPage(virt);
 	}
 
+	// Large pages that were split for unmapping may still be cached on other processors
+	interruptsSendTlbFlush(task->process->pageSpace);
+
+	if(freeBlock)
+		contiguousAllocatorFree(freeBlock);
+
 	addressRangePoolFree(task->process->virtualRangePool, range->base);
 }
 
+/**
+ * Marks a page of the sharing process as shared, so that it does not become
+ * copy-on-write when the process is forked. A pending copy is resolved first.
+ *
+ * @return the physical address of the page
+ */
+g_physical_address _syscallShareMemoryMarkSource(g_task* task, g_virtual_address page)
+{
+	mutexAcquire(&memoryCopyOnWriteLock);
+
+	// Resolving the copy does a TLB shootdown, which must happen without the lock
+	uint64_t entry = pagingVirtualToPageEntry(page);
+	while(entry & G_PAGE_COPY_ON_WRITE_FLAG)
+	{
+		mutexRelease(&memoryCopyOnWriteLock);
+		bool resolved = memoryCopyOnWriteHandlePageFault(task, page);
+		mutexAcquire(&memoryCopyOnWriteLock);
+
+		entry = pagingVirtualToPageEntry(page);
+		if(!resolved)
+			break;
+	}
+
+	if((entry & G_PAGE_PRESENT) && !(entry & G_PAGE_SHARED_FLAG))
+	{
+		pagingMapPage(page, entry & ~G_PAGE_ALIGN_MASK, G_PAGE_TABLE_USER_DEFAULT,
+		              (entry & G_PAGE_ALIGN_MASK) | G_PAGE_SHARED_FLAG, true);
+	}
+
+	mutexRelease(&memoryCopyOnWriteLock);
+	return entry & ~G_PAGE_ALIGN_MASK;
+}
+
 void syscallShareMemory(g_task* task, g_syscall_share_mem* data)
 {
 	data->virtualAddress = 0;
@@ -160,7 +297,7 @@ void syscallShareMemory(g_task* task, g_syscall_share_mem* data)
 
 	for(uint32_t i = 0; i < pages; i++)
 	{
-		g_physical_address physicalAddr = pagingVirtualToPhysical(memory + i * G_PAGE_SIZE);
+		g_physical_address physicalAddr = _syscallShareMemoryMarkSource(task, memory + i * G_PAGE_SIZE);
 
 		targetTask = taskingGetById(data->processId);
 		if(!targetTask)
@@ -174,7 +311,8 @@ void syscallShareMemory(g_task* task, g_syscall_share_mem* data)
 		targetProcess = targetTask->process;
 
 		g_physical_address back = taskingMemoryTemporarySwitchTo(targetProcess->pageSpace);
-		pagingMapPage(virtualRangeBase + i * G_PAGE_SIZE, physicalAddr, G_PAGE_TABLE_USER_DEFAULT, G_PAGE_USER_DEFAULT);
+		pagingMapPage(virtualRangeBase + i * G_PAGE_SIZE, physicalAddr, G_PAGE_TABLE_USER_DEFAULT,
+		              G_PAGE_USER_DEFAULT | G_PAGE_SHARED_FLAG);
 		taskingMemoryTemporarySwitchBack(back);
 		mutexRelease(&targetProcess->lock);
 
@@ -202,7 +340,7 @@ void syscallMapMmioArea(g_task* task, g_syscall_map_mmio* data)
 	for(uint32_t i = 0; i < pages; i++)
 	{
 		pagingMapPage(virtualRangeBase + i * G_PAGE_SIZE, data->physicalAddress + i * G_PAGE_SIZE,
-		              G_PAGE_TABLE_USER_DEFAULT, G_PAGE_USER_DEFAULT);
+		              G_PAGE_TABLE_USER_DEFAULT, G_PAGE_USER_DEFAULT | G_PAGE_SHARED_FLAG);
 	}
 
 	data->virtualAddress = (void*) virtualRangeBase;
@@ -32,6 +32,8 @@ void syscallLowerMemoryFree(g_task* task, g_syscall_lower_free* data);
 
 void syscallAllocateMemory(g_task* task, g_syscall_alloc_mem* data);
 
+void syscallAllocateMemoryContiguous(g_task* task, g_syscall_alloc_mem_contiguous* data);
+
 void syscallUnmap(g_task* task, g_syscall_unmap* data);
 
 void syscallShareMemory(g_task* task, g_syscall_share_mem* data);
@@ -32,10 +32,10 @@ void syscallMessageSend(g_task* task, g_syscall_send_message* data)
 	{
 		taskingWait(task, __func__, [task, data]()
 		{
-			messageQueueWaitForSend(task->id, data->receiver);
+			messageQueueWaitForSend(task, data->receiver);
 		});
 	}
-	messageQueueUnwaitForSend(task->id, data->receiver);
+	messageQueueUnwaitForSend(task, data->receiver);
 }
 
 void syscallMessageReceive(g_task* task, g_syscall_receive_message* data)
@@ -80,8 +80,8 @@ void syscallMessageTopicReceive(g_task* task, g_syscall_receive_topic_message* d
 	{
 		taskingWait(task, __func__, [data, task]()
 		{
-			messageTopicsWaitForReceive(data->topic, task->id);
+			messageTopicsWaitForReceive(data->topic, task);
 		});
 	}
-	messageTopicsUnwaitForReceive(data->topic, task->id);
+	messageTopicsUnwaitForReceive(data->topic, task);
 }
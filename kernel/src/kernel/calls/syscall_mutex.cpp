@@ -21,25 +21,12 @@
 #include "kernel/calls/syscall_mutex.hpp"
 #include "kernel/tasking/user_mutex.hpp"
 
-void syscallMutexInitialize(g_task* task, g_syscall_user_mutex_initialize* data)
+void syscallMutexWait(g_task* task, g_syscall_user_mutex_wait* data)
 {
-	data->mutex = userMutexCreate(data->reentrant);
+	data->status = userMutexWait(task, data->word, data->expected, data->timeout);
 }
 
-void sycallMutexAcquire(g_task* task, g_syscall_user_mutex_acquire* data)
+void syscallMutexWake(g_task* task, g_syscall_user_mutex_wake* data)
 {
-	auto status = userMutexAcquire(task, data->mutex, data->timeout, data->trying);
-	data->wasSet = status == G_USER_MUTEX_STATUS_ACQUIRED;
-	data->hasTimedOut = status == G_USER_MUTEX_STATUS_TIMEOUT;
+	data->woken = userMutexWake(task, data->word, data->count);
 }
-
-void syscallMutexRelease(g_task* task, g_syscall_user_mutex_release* data)
-{
-	userMutexRelease(data->mutex);
-}
-
-void syscallMutexDestroy(g_task* task, g_syscall_user_mutex_destroy* data)
-{
-	userMutexDestroy(data->mutex);
-}
-
@@ -153,8 +153,8 @@ void syscallAwaitIrq(g_task* task, g_syscall_await_irq* data)
 	{
 		if(data->timeout)
 		{
-			clockUnwaitForTime(task->id);
-			clockWaitForTime(task->id, clockGetLocal()->time + data->timeout);
+			clockUnwaitForTime(task);
+			clockWaitForTime(task, clockGetTime() + data->timeout);
 		}
 	});
 }
@@ -25,6 +25,7 @@
 #include "kernel/system/interrupts/interrupts.hpp"
 #include "kernel/tasking/scheduler/scheduler.hpp"
 #include "kernel/tasking/tasking_directory.hpp"
+#include "kernel/tasking/tasking_memory.hpp"
 #include "kernel/tasking/clock.hpp"
 #include "kernel/system/timing/hpet.hpp"
 #include "kernel/utils/wait_queue.hpp"
@@ -35,17 +36,44 @@ void syscallSleep(g_task* task, g_syscall_sleep* data)
 {
 	taskingWait(task, __func__, [task, data]()
 	{
-		clockWaitForTime(task->id, clockGetLocal()->time + data->milliseconds);
+		clockWaitForTime(task, clockGetTime() + data->milliseconds);
 	});
 }
 
 void syscallYield(g_task* task, g_syscall_yield* data)
 {
 	if(data->target != G_TID_NONE)
-		schedulerPrefer(data->target);
+		schedulerPrefer(taskingGetById(data->target));
 	taskingYield();
 }
 
+void syscallTaskSetPriority(g_task* task, g_syscall_task_set_priority* data)
+{
+	if(data->priority != G_TASK_PRIORITY_NORMAL && data->priority != G_TASK_PRIORITY_IDLE &&
+	   data->priority != G_TASK_PRIORITY_HIGH && data->priority != G_TASK_PRIORITY_LOW)
+	{
+		data->status = G_TASK_SET_PRIORITY_STATUS_INVALID;
+		return;
+	}
+
+	g_task* target = data->task == G_TID_NONE ? task : taskingGetById(data->task);
+	if(!target)
+	{
+		data->status = G_TASK_SET_PRIORITY_STATUS_NOT_FOUND;
+		return;
+	}
+
+	if(task->securityLevel > G_SECURITY_LEVEL_DRIVER &&
+	   (target->process != task->process || data->priority == G_TASK_PRIORITY_HIGH))
+	{
+		data->status = G_TASK_SET_PRIORITY_STATUS_NOT_PERMITTED;
+		return;
+	}
+
+	schedulerSetPriority(target, data->priority);
+	data->status = G_TASK_SET_PRIORITY_STATUS_SUCCESSFUL;
+}
+
 void syscallExit(g_task* task, g_syscall_exit* data)
 {
 	waitQueueWake(&task->process->main->waitersJoin);
@@ -86,7 +114,7 @@ void syscallJoin(g_task* task, g_syscall_join* data)
 {
 	taskingWait(task, __func__, [task ,data]()
 	{
-		taskingWaitForExit(data->taskId, task->id);
+		taskingWaitForExit(data->taskId, task);
 	});
 }
 
@@ -123,7 +151,7 @@ void syscallSpawn(g_task* task, g_syscall_spawn* data)
 			if(data->workdir)
 				target.process->environment.workingDirectory = stringDuplicate(data->workdir);
 
-			target.process->main->status = G_TASK_STATUS_RUNNING;
+			taskingWake(target.process->main);
 		}
 	}
 	else
@@ -153,6 +181,7 @@ void syscallKill(g_task* task, g_syscall_kill* data)
 		data->status = G_KILL_STATUS_SUCCESSFUL;
 		target->process->main->status = G_TASK_STATUS_DEAD;
 		mutexRelease(&target->lock);
+		schedulerNotifyDead(target->process->main);
 		waitQueueWake(&target->waitersJoin);
 		taskingYield();
 		INTERRUPTS_RESUME;
@@ -197,7 +226,28 @@ void syscallGetTaskEntry(g_task* task, g_syscall_get_task_entry* data)
 
 void syscallFork(g_task* task, g_syscall_fork* data)
 {
-	logInfo("syscall not implemented: fork");
+	data->forkedId = G_PID_NONE;
+
+	if(task->securityLevel == G_SECURITY_LEVEL_KERNEL)
+	{
+		logInfo("%! kernel task %i tried to fork", "syscall", task->id);
+		return;
+	}
+
+	g_task* child = taskingFork(task);
+	if(!child)
+	{
+		logInfo("%! task %i failed to fork", "syscall", task->id);
+		return;
+	}
+
+	// The forked process sees 0 as the result
+	g_physical_address back = taskingMemoryTemporarySwitchTo(child->process->pageSpace);
+	data->forkedId = 0;
+	taskingMemoryTemporarySwitchBack(back);
+
+	taskingAssignBalanced(child);
+	data->forkedId = child->process->id;
 }
 
 void syscallGetParentProcessId(g_task* task, g_syscall_get_parent_pid* data)
@@ -207,7 +257,7 @@ void syscallGetParentProcessId(g_task* task, g_syscall_get_parent_pid* data)
 
 void syscallGetMilliseconds(g_task* task, g_syscall_millis* data)
 {
-	data->millis = clockGetLocal()->time;
+	data->millis = clockGetTime();
 }
 
 void syscallGetNanoseconds(g_task* task, g_syscall_nanos* data)
@@ -215,7 +265,7 @@ void syscallGetNanoseconds(g_task* task, g_syscall_nanos* data)
 	if(hpetIsAvailable())
 		data->nanos = hpetGetNanos();
 	else
-		data->nanos = clockGetLocal()->time * 1000000LL;
+		data->nanos = clockGetTime() * 1000000LL;
 }
 
 void syscallGetExecutablePath(g_task* task, g_syscall_get_executable_path* data)
@@ -303,15 +353,15 @@ void syscallTaskAwaitByName(g_task* task, g_syscall_task_await_by_name* data)
 	{
 		taskingWait(task, __func__, [data, task]()
 		{
-			clockWaitForTime(task->id, clockGetLocal()->time + 100);
-			taskingDirectoryWaitForRegister(data->name, task->id);
+			clockWaitForTime(task, clockGetTime() + 100);
+			taskingDirectoryWaitForRegister(data->name, task);
 		});
-		clockUnwaitForTime(task->id);
-		taskingDirectoryUnwaitForRegister(data->name, task->id);
+		clockUnwaitForTime(task);
+		taskingDirectoryUnwaitForRegister(data->name, task);
 
 		taskingWait(task, __func__, [data, task]()
 		{
-			clockWaitForTime(task->id, clockGetLocal()->time + 500);
+			clockWaitForTime(task, clockGetTime() + 500);
 		});
 	}
 	data->task = target;
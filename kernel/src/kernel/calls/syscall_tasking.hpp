@@ -30,6 +30,8 @@ void syscallExitTask(g_task* task);
 
 void syscallYield(g_task* task, g_syscall_yield* data);
 
+void syscallTaskSetPriority(g_task* task, g_syscall_task_set_priority* data);
+
 void syscallGetProcessId(g_task* task, g_syscall_get_pid* data);
 
 void syscallGetTaskId(g_task* task, g_syscall_get_tid* data);
@@ -394,11 +394,7 @@ g_fs_read_status filesystemRead(g_task* task, g_fd fd, uint8_t* buffer, uint64_t
 			      "filesytem", task->id, node->id);
 
 		INTERRUPTS_PAUSE;
-		mutexAcquire(&task->lock);
-		task->status = G_TASK_STATUS_WAITING;
-		task->waitsFor = "read";
-		mutexRelease(&task->lock);
-		delegate->waitForRead(task->id, node);
+		delegate->waitForRead(task, node);
 		taskingYield();
 		INTERRUPTS_RESUME;
 	}
@@ -478,11 +474,7 @@ g_fs_write_status filesystemWrite(g_task* task, g_fd fd, uint8_t* buffer, uint64
 			      "filesytem", task->id, node->id);
 
 		INTERRUPTS_PAUSE;
-		mutexAcquire(&task->lock);
-		task->status = G_TASK_STATUS_WAITING;
-		task->waitsFor = "write";
-		mutexRelease(&task->lock);
-		delegate->waitForWrite(task->id, node);
+		delegate->waitForWrite(task, node);
 		taskingYield();
 		INTERRUPTS_RESUME;
 	}
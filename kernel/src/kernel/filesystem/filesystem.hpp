@@ -76,8 +76,13 @@ struct g_fs_delegate
     g_fs_close_status (*close)(g_fs_node* node, g_file_flag_mode openFlags);
     g_fs_directory_refresh_status (*refreshDir)(g_fs_node* node);
 
-    void (*waitForRead)(g_tid task, g_fs_node* node);
-    void (*waitForWrite)(g_tid task, g_fs_node* node);
+    /**
+     * Set the task waiting until the node can be read or written, or leave it
+     * running if that is already possible. Locks must be taken while the task
+     * is still running, otherwise it can't sleep on a contended lock.
+     */
+    void (*waitForRead)(g_task* task, g_fs_node* node);
+    void (*waitForWrite)(g_task* task, g_fs_node* node);
 };
 
 struct g_filesystem_find_result
@@ -58,12 +58,12 @@ g_fs_open_status filesystemPipeDelegateTruncate(g_fs_node* file)
 	return pipeTruncate(file->physicalId);
 }
 
-void filesystemPipeDelegateWaitForRead(g_tid task, g_fs_node* node)
+void filesystemPipeDelegateWaitForRead(g_task* task, g_fs_node* node)
 {
 	pipeWaitForRead(task, node->physicalId);
 }
 
-void filesystemPipeDelegateWaitForWrite(g_tid task, g_fs_node* node)
+void filesystemPipeDelegateWaitForWrite(g_task* task, g_fs_node* node)
 {
 	pipeWaitForWrite(task, node->physicalId);
 }
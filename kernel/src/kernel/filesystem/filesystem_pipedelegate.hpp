@@ -39,8 +39,8 @@ g_fs_length_status filesystemPipeDelegateGetLength(g_fs_node* node, uint64_t* ou
 
 g_fs_open_status filesystemPipeDelegateTruncate(g_fs_node* file);
 
-void filesystemPipeDelegateWaitForRead(g_tid task, g_fs_node* node);
+void filesystemPipeDelegateWaitForRead(g_task* task, g_fs_node* node);
 
-void filesystemPipeDelegateWaitForWrite(g_tid task, g_fs_node* node);
+void filesystemPipeDelegateWaitForWrite(g_task* task, g_fs_node* node);
 
 #endif
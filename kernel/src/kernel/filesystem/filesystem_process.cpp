@@ -20,9 +20,11 @@
 
 #include "kernel/filesystem/filesystem_process.hpp"
 #include "kernel/memory/memory.hpp"
+#include "kernel/memory/object_cache.hpp"
 #include "kernel/logger/logger.hpp"
 
 static g_hashmap<g_pid, g_filesystem_process*>* filesystemProcessInfo;
+static g_object_cache filesystemDescriptorCache = G_OBJECT_CACHE_INITIALIZER("file-descriptor", g_file_descriptor);
 
 void filesystemProcessInitialize()
 {
@@ -49,7 +51,7 @@ g_fs_open_status filesystemProcessCreateDescriptor(g_pid pid, g_fs_virt_id nodeI
 		return G_FS_OPEN_ERROR;
 	}
 
-	g_file_descriptor* descriptor = (g_file_descriptor*) heapAllocate(sizeof(g_file_descriptor));
+	g_file_descriptor* descriptor = (g_file_descriptor*) objectCacheAllocate(&filesystemDescriptorCache);
 
 	if(optionalFd == G_FD_NONE)
 	{
@@ -93,7 +95,7 @@ void filesystemProcessRemove(g_pid pid)
 	{
 		g_hashmap_entry<g_fd, g_file_descriptor*>* entry = hashmapIteratorNext<g_fd, g_file_descriptor*>(&iter);
 		filesystemClose(pid, entry->key, false);
-		heapFree(entry->value);
+		objectCacheFree(&filesystemDescriptorCache, entry->value);
 	}
 	hashmapIteratorEnd<g_fd, g_file_descriptor*>(&iter);
 
@@ -112,7 +114,7 @@ void filesystemProcessRemoveDescriptor(g_pid pid, g_fd fd)
 		return;
 
 	hashmapRemove(info->descriptors, fd);
-	heapFree(descriptor);
+	objectCacheFree(&filesystemDescriptorCache, descriptor);
 }
 
 g_fs_clonefd_status filesystemProcessCloneDescriptor(g_pid sourcePid, g_fd sourceFd, g_pid targetPid, g_fd targetFd, g_fd* outFd)
@@ -173,3 +175,30 @@ void filesystemProcessCreateStdio(g_pid sourcePid, g_fd* sourceStdio, g_pid targ
 	filesystemProcessCreateStdioPipe(sourcePid, sourceStdio[1], targetPid, 1, &targetStdio[1]);
 	filesystemProcessCreateStdioPipe(sourcePid, sourceStdio[2], targetPid, 2, &targetStdio[2]);
 }
+
+void filesystemProcessCloneAll(g_pid sourcePid, g_pid targetPid)
+{
+	g_filesystem_process* source = hashmapGet<g_pid, g_filesystem_process*>(filesystemProcessInfo, sourcePid, 0);
+	g_filesystem_process* target = hashmapGet<g_pid, g_filesystem_process*>(filesystemProcessInfo, targetPid, 0);
+	if(!source || !target)
+		return;
+
+	g_hashmap_iterator<g_fd, g_file_descriptor*> iter = hashmapIteratorStart<g_fd, g_file_descriptor*>(source->descriptors);
+	while(hashmapIteratorHasNext<g_fd, g_file_descriptor*>(&iter))
+	{
+		g_hashmap_entry<g_fd, g_file_descriptor*>* entry = hashmapIteratorNext<g_fd, g_file_descriptor*>(&iter);
+
+		g_fd clonedFd;
+		if(filesystemProcessCloneDescriptor(sourcePid, entry->key, targetPid, entry->key, &clonedFd) != G_FS_CLONEFD_SUCCESSFUL)
+			logInfo("%! failed to clone fd %i:%i to process %i", "filesystem", sourcePid, entry->key, targetPid);
+	}
+	hashmapIteratorEnd<g_fd, g_file_descriptor*>(&iter);
+
+	mutexAcquire(&source->nextDescriptorLock);
+	g_fd nextDescriptor = source->nextDescriptor;
+	mutexRelease(&source->nextDescriptorLock);
+
+	mutexAcquire(&target->nextDescriptorLock);
+	target->nextDescriptor = nextDescriptor;
+	mutexRelease(&target->nextDescriptorLock);
+}
@@ -89,4 +89,9 @@ g_fs_clonefd_status filesystemProcessCloneDescriptor(g_pid sourcePid, g_fd sourc
  */
 void filesystemProcessCreateStdio(g_pid sourcePid, g_fd* sourceStdio, g_pid targetPid, g_fd* targetStdio);
 
+/**
+ * Clones all file descriptors of a process into another process, keeping their ids.
+ */
+void filesystemProcessCloneAll(g_pid sourcePid, g_pid targetPid);
+
 #endif
@@ -20,7 +20,9 @@
 
 #include "kernel/ipc/message_queues.hpp"
 #include "kernel/memory/memory.hpp"
+#include "kernel/memory/object_cache.hpp"
 #include "kernel/tasking/tasking.hpp"
+#include "kernel/tasking/scheduler/scheduler.hpp"
 #include "kernel/utils/hashmap.hpp"
 
 #include "kernel/logger/logger.hpp"
@@ -30,6 +32,7 @@ static g_mutex messageTxLock;
 
 static g_hashmap<g_tid, g_message_queue*>* messageQueues = nullptr;
 static g_mutex messageQueuesLock;
+static g_object_cache messageQueueCache = G_OBJECT_CACHE_INITIALIZER("message-queue", g_message_queue);
 
 void _messageQueuesRemove(g_message_queue* queue, g_message_header* message);
 void _messageQueuesAddToTail(g_message_queue* queue, g_message_header* message);
@@ -39,8 +42,8 @@ g_message_queue* _messageQueuesGetOrCreate(g_tid receiver);
 void messageQueuesInitialize()
 {
 	messageQueues = hashmapCreateNumeric<g_tid, g_message_queue*>(64);
-	mutexInitializeTask(&messageTxLock);
-	mutexInitializeGlobal(&messageQueuesLock);
+	mutexInitializeTask(&messageTxLock, __func__);
+	mutexInitializeGlobal(&messageQueuesLock, __func__);
 }
 
 g_message_send_status messageQueueSend(g_tid sender, g_tid receiver, void* content, uint32_t length,
@@ -71,6 +74,13 @@ g_message_send_status messageQueueSend(g_tid sender, g_tid receiver, void* conte
 		_messageQueuesAddToTail(queue, message);
 		_messageQueuesWakeWaitingReceiver(queue);
 		status = G_MESSAGE_SEND_STATUS_SUCCESSFUL;
+
+		// Senders are woken one by one, pass on to the next one while there is space
+		mutexAcquire(&queue->lock);
+		bool hasSpace = queue->size < G_MESSAGE_MAXIMUM_QUEUE_CONTENT;
+		mutexRelease(&queue->lock);
+		if(hasSpace)
+			waitQueueWakeOne(&queue->waitersSend);
 	}
 
 	return status;
@@ -79,12 +89,8 @@ g_message_send_status messageQueueSend(g_tid sender, g_tid receiver, void* conte
 g_message_receive_status messageQueueReceive(g_tid receiver, g_message_header* out, uint32_t max,
                                              g_message_transaction tx)
 {
-	auto receiverEntry = hashmapGetEntry(messageQueues, receiver);
-
-	g_message_queue* queue;
-	if(receiverEntry)
-		queue = receiverEntry->value;
-	else
+	auto queue = hashmapGet<g_tid, g_message_queue*>(messageQueues, receiver, nullptr);
+	if(!queue)
 		return G_MESSAGE_RECEIVE_STATUS_EMPTY;
 
 	mutexAcquire(&queue->lock);
@@ -110,7 +116,7 @@ g_message_receive_status messageQueueReceive(g_tid receiver, g_message_header* o
 			memoryCopy(out, message, len);
 			_messageQueuesRemove(queue, message);
 			heapFree(message);
-			waitQueueWake(&queue->waitersSend);
+			waitQueueWakeOne(&queue->waitersSend);
 			status = G_MESSAGE_RECEIVE_STATUS_SUCCESSFUL;
 		}
 	}
@@ -137,10 +143,9 @@ void messageQueueTaskRemoved(g_tid task)
 {
 	mutexAcquire(&messageQueuesLock);
 
-	auto receiverEntry = hashmapGetEntry(messageQueues, task);
-	if(receiverEntry)
+	auto queue = hashmapGet<g_tid, g_message_queue*>(messageQueues, task, nullptr);
+	if(queue)
 	{
-		g_message_queue* queue = receiverEntry->value;
 		mutexAcquire(&queue->lock);
 
 		g_message_header* head = queue->head;
@@ -153,20 +158,21 @@ void messageQueueTaskRemoved(g_tid task)
 
 		mutexRelease(&queue->lock);
 
+		waitQueueDestroy(&queue->waitersSend);
 		hashmapRemove(messageQueues, task);
-		heapFree(queue);
+		objectCacheFree(&messageQueueCache, queue);
 	}
 
 	mutexRelease(&messageQueuesLock);
 }
 
-void messageQueueWaitForSend(g_tid sender, g_tid receiver)
+void messageQueueWaitForSend(g_task* sender, g_tid receiver)
 {
 	g_message_queue* queue = _messageQueuesGetOrCreate(receiver);
 	waitQueueAdd(&queue->waitersSend, sender);
 }
 
-void messageQueueUnwaitForSend(g_tid sender, g_tid receiver)
+void messageQueueUnwaitForSend(g_task* sender, g_tid receiver)
 {
 	g_message_queue* queue = _messageQueuesGetOrCreate(receiver);
 	waitQueueRemove(&queue->waitersSend, sender);
@@ -176,6 +182,9 @@ void _messageQueuesWakeWaitingReceiver(g_message_queue* queue)
 {
 	g_task* task = taskingGetById(queue->task);
 	taskingWake(task);
+
+	// Let the receiver run right away once the sender waits for the response
+	schedulerPrefer(task);
 }
 
 void _messageQueuesRemove(g_message_queue* queue, g_message_header* message)
@@ -225,18 +234,17 @@ void _messageQueuesAddToTail(g_message_queue* queue, g_message_header* message)
 
 g_message_queue* _messageQueuesGetOrCreate(g_tid receiver)
 {
-	mutexAcquire(&messageQueuesLock);
-
-	auto entry = hashmapGetEntry(messageQueues, receiver);
+	// Existing queues are found under the read lock of the map only
+	auto queue = hashmapGet<g_tid, g_message_queue*>(messageQueues, receiver, nullptr);
+	if(queue)
+		return queue;
 
-	g_message_queue* queue;
-	if(entry)
-	{
-		queue = entry->value;
-	}
-	else
+	// Another task may have created the queue in the meantime
+	mutexAcquire(&messageQueuesLock);
+	queue = hashmapGet<g_tid, g_message_queue*>(messageQueues, receiver, nullptr);
+	if(!queue)
 	{
-		queue = (g_message_queue*) heapAllocate(sizeof(g_message_queue));
+		queue = (g_message_queue*) objectCacheAllocate(&messageQueueCache);
 		mutexInitializeTask(&queue->lock, __func__);
 		queue->task = receiver;
 		queue->size = 0;
@@ -70,12 +70,12 @@ void messageQueueTaskRemoved(g_tid task);
 /**
  * Adds the sender to the list of waiters that wait for free space in the receivers queue.
  */
-void messageQueueWaitForSend(g_tid sender, g_tid receiver);
+void messageQueueWaitForSend(g_task* sender, g_tid receiver);
 
 /**
  * Removes the sender from the send-wait queue.
  */
-void messageQueueUnwaitForSend(g_tid sender, g_tid receiver);
+void messageQueueUnwaitForSend(g_task* sender, g_tid receiver);
 
 /**
  * Adds the receiver to the list of waiters that wait for new messages in the receivers queue.
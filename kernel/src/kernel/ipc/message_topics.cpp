@@ -32,7 +32,7 @@ void _messageTopicsAddToTail(g_message_topic* topic, g_message_header* message);
 void messageTopicsInitialize()
 {
 	messageTopics = hashmapCreateString<g_message_topic*>(64);
-	mutexInitializeGlobal(&messageTopicsLock);
+	mutexInitializeGlobal(&messageTopicsLock, __func__);
 }
 
 g_message_send_status messageTopicsPost(const char* topicName, g_tid sender, void* content, uint32_t length)
@@ -120,13 +120,13 @@ g_message_topic* _messageTopicsGetOrCreate(const char* name)
 	return topic;
 }
 
-void messageTopicsWaitForReceive(const char* topicName, g_tid receiver)
+void messageTopicsWaitForReceive(const char* topicName, g_task* receiver)
 {
 	auto topic = _messageTopicsGetOrCreate(topicName);
 	waitQueueAdd(&topic->waitersReceive, receiver);
 }
 
-void messageTopicsUnwaitForReceive(const char* topicName, g_tid receiver)
+void messageTopicsUnwaitForReceive(const char* topicName, g_task* receiver)
 {
 	auto topic = _messageTopicsGetOrCreate(topicName);
 	waitQueueRemove(&topic->waitersReceive, receiver);
@@ -62,11 +62,11 @@ g_message_receive_status messageTopicsReceive(const char* topicName, g_message_t
 /**
  * Adds the task to the receive-wait queue of the topic.
  */
-void messageTopicsWaitForReceive(const char* topicName, g_tid receiver);
+void messageTopicsWaitForReceive(const char* topicName, g_task* receiver);
 
 /**
  * Removes the task from the receive-wait queue of the topic.
  */
-void messageTopicsUnwaitForReceive(const char* topicName, g_tid receiver);
+void messageTopicsUnwaitForReceive(const char* topicName, g_task* receiver);
 
 #endif
@@ -20,6 +20,7 @@
 
 #include "kernel/ipc/pipes.hpp"
 #include "kernel/memory/memory.hpp"
+#include "kernel/tasking/tasking.hpp"
 #include "kernel/utils/hashmap.hpp"
 
 #include "kernel/logger/logger.hpp"
@@ -57,6 +58,8 @@ g_fs_pipe_status pipeCreate(g_fs_phys_id* outPipeId)
 
 void pipeDeleteInternal(g_fs_phys_id pipeId, g_pipeline* pipe)
 {
+	waitQueueDestroy(&pipe->waitersRead);
+	waitQueueDestroy(&pipe->waitersWrite);
 	memoryFreeKernelRange((g_virtual_address) pipe->buffer);
 	heapFree(pipe);
 	hashmapRemove(pipeMap, pipeId);
@@ -170,7 +173,11 @@ g_fs_read_status pipeRead(g_fs_phys_id pipeId, uint8_t* buffer, uint64_t offset,
 
 		*outRead = length;
 		status = G_FS_READ_SUCCESSFUL;
-		waitQueueWake(&pipe->waitersWrite);
+		waitQueueWakeOne(&pipe->waitersWrite, true);
+
+		// Readers are woken one by one, pass on to the next one if data is left
+		if(pipe->size > 0)
+			waitQueueWakeOne(&pipe->waitersRead);
 	}
 	else
 	{
@@ -221,7 +228,11 @@ g_fs_write_status pipeWrite(g_fs_phys_id pipeId, uint8_t* buffer, uint64_t offse
 		*outWrote = length;
 
 		status = G_FS_WRITE_SUCCESSFUL;
-		waitQueueWake(&pipe->waitersRead);
+		waitQueueWakeOne(&pipe->waitersRead, true);
+
+		// Writers are woken one by one, pass on to the next one if space is left
+		if(pipe->size < pipe->capacity)
+			waitQueueWakeOne(&pipe->waitersWrite);
 	}
 	else
 	{
@@ -253,25 +264,48 @@ g_fs_open_status pipeTruncate(g_fs_phys_id pipeId)
 	pipe->size = 0;
 	pipe->readPosition = pipe->buffer;
 	pipe->writePosition = pipe->buffer;
+	waitQueueWake(&pipe->waitersWrite);
 	mutexRelease(&pipe->lock);
 
 	return G_FS_OPEN_SUCCESSFUL;
 }
 
-void pipeWaitForRead(g_tid task, g_fs_phys_id pipeId)
+/**
+ * Adds the task to the wait queue and only then sets it waiting, as taking the
+ * queue lock might have to sleep. The pipe lock must be held so that the task can
+ * not be woken in between.
+ */
+void _pipeWait(g_task* task, g_wait_queue* queue, const char* waitsFor)
+{
+	waitQueueAdd(queue, task);
+
+	mutexAcquire(&task->lock);
+	task->status = G_TASK_STATUS_WAITING;
+	task->waitsFor = waitsFor;
+	mutexRelease(&task->lock);
+}
+
+void pipeWaitForRead(g_task* task, g_fs_phys_id pipeId)
 {
 	g_pipeline* pipe = pipeGetById(pipeId);
 	if(!pipe)
 		return;
 
-	waitQueueAdd(&pipe->waitersRead, task);
+	// Check again under the lock, data might have been written since the read
+	mutexAcquire(&pipe->lock);
+	if(pipe->size == 0 && pipe->referencesWrite > 0)
+		_pipeWait(task, &pipe->waitersRead, "read");
+	mutexRelease(&pipe->lock);
 }
 
-void pipeWaitForWrite(g_tid task, g_fs_phys_id pipeId)
+void pipeWaitForWrite(g_task* task, g_fs_phys_id pipeId)
 {
 	g_pipeline* pipe = pipeGetById(pipeId);
 	if(!pipe)
 		return;
 
-	waitQueueAdd(&pipe->waitersWrite, task);
+	mutexAcquire(&pipe->lock);
+	if(pipe->size >= pipe->capacity && pipe->referencesRead > 0)
+		_pipeWait(task, &pipe->waitersWrite, "write");
+	mutexRelease(&pipe->lock);
 }
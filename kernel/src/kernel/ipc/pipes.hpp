@@ -96,7 +96,11 @@ g_fs_open_status pipeTruncate(g_fs_phys_id pipeId);
  */
 void pipeDeleteInternal(g_fs_phys_id pipeId, g_pipeline* pipe);
 
-void pipeWaitForRead(g_tid task, g_fs_phys_id pipeId);
-void pipeWaitForWrite(g_tid task, g_fs_phys_id pipeId);
+/**
+ * Adds the task to the wait queue of readers or writers and sets it waiting. If the
+ * pipe can already be read or written, the task is left running instead.
+ */
+void pipeWaitForRead(g_task* task, g_fs_phys_id pipeId);
+void pipeWaitForWrite(g_task* task, g_fs_phys_id pipeId);
 
 #endif
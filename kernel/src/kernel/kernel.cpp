@@ -144,6 +144,7 @@ void kernelRunBootstrapCore()
 
 	systemInitializeBsp((g_physical_address) rsdpRequest.response->address);
 	clockInitialize();
+	waitQueuesInitialize();
 	filesystemInitialize();
 	pipeInitialize();
 	messageQueuesInitialize();
@@ -198,7 +199,7 @@ void kernelSpawnService(const char* path, const char* args, g_security_level sec
 		if(spawnRes.status == G_SPAWN_STATUS_SUCCESSFUL)
 		{
 			spawnRes.process->environment.arguments = args;
-			spawnRes.process->main->status = G_TASK_STATUS_RUNNING;
+			taskingWake(spawnRes.process->main);
 			logInfo("%! %s started in process %i", "service", path, spawnRes.process->id);
 		}
 		else
@@ -238,7 +239,7 @@ void kernelInitializationThread()
 	// 	auto task = taskingGetCurrentTask();
 	// 	taskingWait(task, __func__, [task]()
 	// 	{
-	// 		clockWaitForTime(task->id, clockGetLocal()->time + 1000);
+	// 		clockWaitForTime(task, clockGetLocal()->time + 1000);
 	// 	});
 	// 	logInfo("alive...");
 	// }
@@ -21,20 +21,28 @@
 #include "kernel/memory/bitmap_page_allocator.hpp"
 #include "kernel/logger/logger.hpp"
 #include "kernel/memory/constants.hpp"
+#include "kernel/memory/heap.hpp"
 #include "kernel/system/mutex.hpp"
+#include "kernel/system/interrupts/interrupts.hpp"
+#include "kernel/system/processor/processor.hpp"
+#include "kernel/system/system.hpp"
 #include "kernel/panic.hpp"
 
-void _bitmapPageAllocatorFastBufferInitialize(g_bitmap_page_allocator* allocator);
-bool _bitmapPageAllocatorFastBufferFree(g_bitmap_page_allocator* allocator, g_physical_address address);
-g_physical_address _bitmapPageAllocatorFastBufferAllocate(g_bitmap_page_allocator* allocator);
+g_bitmap_page_magazine* _bitmapPageAllocatorGetMagazine(g_bitmap_page_allocator* allocator);
+uint32_t _bitmapPageAllocatorTake(g_bitmap_page_allocator* allocator, g_physical_address* out, uint32_t count);
+void _bitmapPageAllocatorGive(g_bitmap_page_allocator* allocator, g_physical_address* pages, uint32_t count);
 g_physical_address _bitmapPageAllocatorEarlyAllocate(limine_memmap_response* memoryMap, int pages);
 g_bitmap_header* _bitmapPageAllocatorInitializeBitmap(g_physical_address addr);
+g_bitmap_header* _bitmapPageAllocatorFindBitmap(g_bitmap_page_allocator* allocator, g_physical_address address);
+bool _bitmapPageAllocatorSetFree(g_bitmap_header* bitmap, size_t totalBitIndex);
+bool _bitmapPageAllocatorIsRunFree(g_bitmap_header* bitmap, size_t totalBitIndex, size_t count);
 
 
 void bitmapPageAllocatorInitialize(g_bitmap_page_allocator* allocator, limine_memmap_response* memoryMap)
 {
-	mutexInitializeGlobal(&allocator->lock);
 	allocator->freePageCount = 0;
+	allocator->magazines = nullptr;
+	allocator->magazinesCreating = false;
 
 	// Allocate top-level index page that keeps pointers to bitmaps
 	g_physical_address indexPagePhys = _bitmapPageAllocatorEarlyAllocate(memoryMap, 1);
@@ -42,15 +50,19 @@ void bitmapPageAllocatorInitialize(g_bitmap_page_allocator* allocator, limine_me
 	for(size_t i = 0; i < G_BITMAP_INDEX_MAX_ENTRIES; i++)
 		allocator->indexPage->entries[i] = nullptr;
 
-	int indexEntry = 0;
+	uint32_t indexEntry = 0;
 	for(int i = 0; i < memoryMap->entry_count; i++)
 	{
 		auto entry = memoryMap->entries[i];
-		if(entry->type != LIMINE_MEMMAP_USABLE)
+		if(entry->type != LIMINE_MEMMAP_USABLE || entry->length < G_PAGE_SIZE)
 			continue;
 
 		g_physical_address currentPage = entry->base;
 
+		// Currently only one index page is supported
+		if(indexEntry >= G_BITMAP_INDEX_MAX_ENTRIES)
+			goto stopFilling;
+
 		// At the start of every free area, create a bitmap
 		auto bitmap = _bitmapPageAllocatorInitializeBitmap(currentPage);
 		allocator->indexPage->entries[indexEntry++] = bitmap;
@@ -59,9 +71,7 @@ void bitmapPageAllocatorInitialize(g_bitmap_page_allocator* allocator, limine_me
 		while(currentPage < entry->base + entry->length)
 		{
 			size_t entryIndex = (currentPage - bitmap->base) / G_PAGE_SIZE;
-			size_t bitmapIndex = entryIndex / G_BITMAP_BITS_PER_ENTRY;
-			size_t bitmapBit = entryIndex % G_BITMAP_BITS_PER_ENTRY;
-			bitmap->entries[bitmapIndex] |= (1 << bitmapBit);
+			_bitmapPageAllocatorSetFree(bitmap, entryIndex);
 			allocator->freePageCount++;
 
 			// Go to next page
@@ -89,7 +99,7 @@ void bitmapPageAllocatorInitialize(g_bitmap_page_allocator* allocator, limine_me
 	}
 
 stopFilling:
-	_bitmapPageAllocatorFastBufferInitialize(allocator);
+	allocator->bitmapCount = indexEntry;
 }
 
 g_bitmap_header* _bitmapPageAllocatorInitializeBitmap(g_physical_address addrPhys)
@@ -98,8 +108,11 @@ g_bitmap_header* _bitmapPageAllocatorInitializeBitmap(g_physical_address addrPhy
 
 	bitmap->base = addrPhys + G_PAGE_SIZE;
 	bitmap->end = addrPhys + G_PAGE_SIZE;
-	mutexInitializeGlobal(&bitmap->lock);
+	mutexInitializeGlobal(&bitmap->lock, __func__);
+	bitmap->freeCount = 0;
 
+	for(size_t word = 0; word < G_BITMAP_SUMMARY_WORDS; word++)
+		bitmap->summary[word] = 0;
 	for(size_t entry = 0; entry < G_BITMAP_MAX_ENTRIES; entry++)
 		bitmap->entries[entry] = 0;
 
@@ -139,135 +152,262 @@ void bitmapPageAllocatorMarkFree(g_bitmap_page_allocator* allocator, g_physical_
 	if(G_PAGE_ALIGN_DOWN(address) != address)
 		panic("%! attempted to free unaligned physical address %x", "bitmap", address);
 
-	if(_bitmapPageAllocatorFastBufferFree(allocator, address))
-		return;
+	INTERRUPTS_PAUSE;
+	g_bitmap_page_magazine* magazine = _bitmapPageAllocatorGetMagazine(allocator);
+	if(magazine)
+	{
+		if(magazine->count == G_BITMAP_ALLOCATOR_MAGAZINE_SIZE)
+		{
+			magazine->count -= G_BITMAP_ALLOCATOR_BATCH;
+			_bitmapPageAllocatorGive(allocator, &magazine->pages[magazine->count], G_BITMAP_ALLOCATOR_BATCH);
+		}
+		magazine->pages[magazine->count++] = address;
+	}
+	else
+	{
+		_bitmapPageAllocatorGive(allocator, &address, 1);
+	}
+	INTERRUPTS_RESUME;
+}
+
+g_physical_address bitmapPageAllocatorAllocate(g_bitmap_page_allocator* allocator)
+{
+	g_physical_address result = 0;
 
-	bool success = false;
+	INTERRUPTS_PAUSE;
+	g_bitmap_page_magazine* magazine = _bitmapPageAllocatorGetMagazine(allocator);
+	if(magazine)
+	{
+		if(magazine->count == 0)
+			magazine->count = _bitmapPageAllocatorTake(allocator, magazine->pages, G_BITMAP_ALLOCATOR_BATCH);
 
-	for(size_t i = 0; i < G_BITMAP_INDEX_MAX_ENTRIES; i++)
+		if(magazine->count > 0)
+			result = magazine->pages[--magazine->count];
+	}
+	else
 	{
-		g_bitmap_header* bitmap = allocator->indexPage->entries[i];
-		if(!bitmap)
-			break;
+		_bitmapPageAllocatorTake(allocator, &result, 1);
+	}
+	INTERRUPTS_RESUME;
+
+	if(!result)
+		panic("%! failed to allocate physical memory", "bitmap");
+	return result;
+}
+
+g_physical_address bitmapPageAllocatorAllocateLarge(g_bitmap_page_allocator* allocator)
+{
+	const size_t runPages = G_PAGE_LARGE_SIZE / G_PAGE_SIZE;
+
+	for(uint32_t bitmapIndex = 0; bitmapIndex < allocator->bitmapCount; bitmapIndex++)
+	{
+		auto bitmap = allocator->indexPage->entries[bitmapIndex];
+		if(bitmap->freeCount < runPages)
+			continue;
 
-		// TODO: Try acquire would be cool here
 		mutexAcquire(&bitmap->lock);
-		if(address >= bitmap->base && address < bitmap->end)
+		size_t totalBits = (bitmap->end - bitmap->base) / G_PAGE_SIZE;
+		size_t first = (G_PAGE_LARGE_ALIGN_UP(bitmap->base) - bitmap->base) / G_PAGE_SIZE;
+		for(size_t index = first; index + runPages <= totalBits; index += runPages)
 		{
-			size_t totalBitIndex = (address - bitmap->base) / G_PAGE_SIZE;
-			size_t bitmapIndex = totalBitIndex / G_BITMAP_BITS_PER_ENTRY;
-			size_t bitmapBit = totalBitIndex % G_BITMAP_BITS_PER_ENTRY;
-			bitmap->entries[bitmapIndex] &= ~(1ULL << bitmapBit);
+			if(!_bitmapPageAllocatorIsRunFree(bitmap, index, runPages))
+				continue;
 
-			mutexAcquire(&allocator->lock);
-			allocator->freePageCount++;
-			mutexRelease(&allocator->lock);
+			for(size_t bitIndex = index; bitIndex < index + runPages; bitIndex++)
+			{
+				size_t entryIndex = bitIndex / G_BITMAP_BITS_PER_ENTRY;
+				bitmap->entries[entryIndex] &= ~(1ULL << (bitIndex % G_BITMAP_BITS_PER_ENTRY));
+				if(!bitmap->entries[entryIndex])
+					bitmap->summary[entryIndex / G_BITMAP_BITS_PER_ENTRY] &= ~(1ULL << (entryIndex % G_BITMAP_BITS_PER_ENTRY));
+			}
+			bitmap->freeCount -= runPages;
+			mutexRelease(&bitmap->lock);
 
-			success = true;
+			__sync_fetch_and_sub(&allocator->freePageCount, runPages);
+			return bitmap->base + index * G_PAGE_SIZE;
 		}
 		mutexRelease(&bitmap->lock);
+	}
+	return 0;
+}
+
+uint32_t bitmapPageAllocatorGetFreePageCount(g_bitmap_page_allocator* allocator)
+{
+	uint32_t count = allocator->freePageCount;
 
-		if(success)
-			break;
+	g_bitmap_page_magazine* magazines = allocator->magazines;
+	if(magazines)
+	{
+		for(uint16_t i = 0; i < processorGetNumberOfProcessors(); i++)
+			count += magazines[i].count;
 	}
+	return count;
+}
 
-	if(!success)
-		logWarn("%! failed to free physical address %x", "bitmap", address);
+/**
+ * Returns the magazine of the current processor. Until the system is ready, the number
+ * of processors is not final, so the bitmaps are used directly. Interrupts must be
+ * disabled.
+ *
+ * The magazines are allocated on the heap, which may itself need pages while doing
+ * so; these allocations also go to the bitmaps directly.
+ *
+ * @return the magazine or null if it can't be used yet
+ */
+g_bitmap_page_magazine* _bitmapPageAllocatorGetMagazine(g_bitmap_page_allocator* allocator)
+{
+	if(!systemIsReady())
+		return nullptr;
+
+	if(!allocator->magazines)
+	{
+		if(!__sync_bool_compare_and_swap(&allocator->magazinesCreating, false, true))
+			return nullptr;
+
+		allocator->magazines = (g_bitmap_page_magazine*) heapAllocateClear(
+				sizeof(g_bitmap_page_magazine) * processorGetNumberOfProcessors());
+	}
+	return &allocator->magazines[processorGetCurrentId()];
 }
 
-g_physical_address bitmapPageAllocatorAllocate(g_bitmap_page_allocator* allocator)
+/**
+ * Takes up to count free pages from the bitmaps.
+ *
+ * @return the number of pages written to out
+ */
+uint32_t _bitmapPageAllocatorTake(g_bitmap_page_allocator* allocator, g_physical_address* out, uint32_t count)
 {
-	g_physical_address addressFromFB = _bitmapPageAllocatorFastBufferAllocate(allocator);
-	if(addressFromFB)
-		return addressFromFB;
+	uint32_t taken = 0;
 
-	for(size_t bitmapIndex = 0; bitmapIndex < G_BITMAP_INDEX_MAX_ENTRIES; bitmapIndex++)
+	for(uint32_t bitmapIndex = 0; bitmapIndex < allocator->bitmapCount && taken < count; bitmapIndex++)
 	{
 		auto bitmap = allocator->indexPage->entries[bitmapIndex];
-		if(!bitmap)
-			break;
+		if(bitmap->freeCount == 0)
+			continue;
 
 		mutexAcquire(&bitmap->lock);
-		g_physical_address result = 0;
-		for(size_t entryIndex = 0; entryIndex < G_BITMAP_MAX_ENTRIES; entryIndex++)
+		uint32_t takenHere = 0;
+		for(size_t word = 0; word < G_BITMAP_SUMMARY_WORDS && taken < count; word++)
 		{
-			auto entry = bitmap->entries[entryIndex];
-			if(entry == 0)
-				continue;
-
-			for(int bit = 0; bit < sizeof(entry) * 8; bit++)
+			while(bitmap->summary[word] && taken < count)
 			{
-				if(entry & (1ULL << bit))
+				size_t entryIndex = word * G_BITMAP_BITS_PER_ENTRY + __builtin_ctzll(bitmap->summary[word]);
+
+				while(bitmap->entries[entryIndex] && taken < count)
 				{
+					int bit = __builtin_ctzll(bitmap->entries[entryIndex]);
 					bitmap->entries[entryIndex] &= ~(1ULL << bit);
-					size_t totalBitIndex = entryIndex * G_BITMAP_BITS_PER_ENTRY + bit;
-
-					mutexAcquire(&allocator->lock);
-					allocator->freePageCount--;
-					mutexRelease(&allocator->lock);
 
-					result = bitmap->base + totalBitIndex * G_PAGE_SIZE;
-					goto allocated;
+					size_t totalBitIndex = entryIndex * G_BITMAP_BITS_PER_ENTRY + bit;
+					out[taken++] = bitmap->base + totalBitIndex * G_PAGE_SIZE;
+					takenHere++;
 				}
+
+				if(!bitmap->entries[entryIndex])
+					bitmap->summary[word] &= ~(1ULL << (entryIndex % G_BITMAP_BITS_PER_ENTRY));
 			}
 		}
-	allocated:
+		bitmap->freeCount -= takenHere;
 		mutexRelease(&bitmap->lock);
-		if(result > 0)
-			return result;
 	}
 
-	panic("%! failed to allocate physical memory", "bitmap");
+	__sync_fetch_and_sub(&allocator->freePageCount, taken);
+	return taken;
 }
 
 /**
- * Initializes the "fast buffer" which is used to keep a stack of free pages for faster allocation.
- *
- * @param allocator
+ * Marks the pages as free in the bitmaps they belong to.
  */
-void _bitmapPageAllocatorFastBufferInitialize(g_bitmap_page_allocator* allocator)
+void _bitmapPageAllocatorGive(g_bitmap_page_allocator* allocator, g_physical_address* pages, uint32_t count)
 {
-	mutexInitializeGlobal(&allocator->fastBuffer.lock);
-	for(g_physical_address& cell: allocator->fastBuffer.buffer)
+	uint32_t given = 0;
+
+	for(uint32_t i = 0; i < count; i++)
 	{
-		cell = 0;
+		g_physical_address address = pages[i];
+
+		g_bitmap_header* bitmap = _bitmapPageAllocatorFindBitmap(allocator, address);
+		if(!bitmap)
+		{
+			logWarn("%! failed to free physical address %x", "bitmap", address);
+			continue;
+		}
+
+		mutexAcquire(&bitmap->lock);
+		if(_bitmapPageAllocatorSetFree(bitmap, (address - bitmap->base) / G_PAGE_SIZE))
+			given++;
+		mutexRelease(&bitmap->lock);
 	}
-	allocator->fastBuffer.size = 0;
+
+	__sync_fetch_and_add(&allocator->freePageCount, given);
 }
 
-bool _bitmapPageAllocatorFastBufferFree(g_bitmap_page_allocator* allocator, g_physical_address address)
+/**
+ * Finds the bitmap that covers the address with a binary search. Bounds of a bitmap
+ * never change after initialization, so no lock is needed.
+ */
+g_bitmap_header* _bitmapPageAllocatorFindBitmap(g_bitmap_page_allocator* allocator, g_physical_address address)
 {
-	bool freed = false;
-
-	mutexAcquire(&allocator->fastBuffer.lock);
-	if(allocator->fastBuffer.size < G_BITMAP_ALLOCATOR_FASTBUFFER_SIZE)
+	uint32_t low = 0;
+	uint32_t high = allocator->bitmapCount;
+	while(low < high)
 	{
-		allocator->fastBuffer.buffer[allocator->fastBuffer.size++] = address;
-		freed = true;
+		uint32_t middle = low + (high - low) / 2;
+		g_bitmap_header* bitmap = allocator->indexPage->entries[middle];
+
+		if(address < bitmap->base)
+			high = middle;
+		else if(address >= bitmap->end)
+			low = middle + 1;
+		else
+			return bitmap;
 	}
-	mutexRelease(&allocator->fastBuffer.lock);
-
-	mutexAcquire(&allocator->lock);
-	allocator->freePageCount++;
-	mutexRelease(&allocator->lock);
-
-	return freed;
+	return nullptr;
 }
 
-g_physical_address _bitmapPageAllocatorFastBufferAllocate(g_bitmap_page_allocator* allocator)
+/**
+ * Marks the page with the index as free and updates the summary. The bitmap lock
+ * must be held unless the allocator is being initialized.
+ *
+ * @return false if the page already was free
+ */
+bool _bitmapPageAllocatorSetFree(g_bitmap_header* bitmap, size_t totalBitIndex)
 {
-	g_physical_address address = 0;
-
-	mutexAcquire(&allocator->fastBuffer.lock);
-	if(allocator->fastBuffer.size > 0)
+	size_t entryIndex = totalBitIndex / G_BITMAP_BITS_PER_ENTRY;
+	G_BITMAP_ENTRY_TYPE bit = 1ULL << (totalBitIndex % G_BITMAP_BITS_PER_ENTRY);
+	if(bitmap->entries[entryIndex] & bit)
 	{
-		address = allocator->fastBuffer.buffer[--allocator->fastBuffer.size];
+		logWarn("%! page %x was freed twice", "bitmap", bitmap->base + totalBitIndex * G_PAGE_SIZE);
+		return false;
 	}
-	mutexRelease(&allocator->fastBuffer.lock);
 
-	mutexAcquire(&allocator->lock);
-	allocator->freePageCount--;
-	mutexRelease(&allocator->lock);
+	bitmap->entries[entryIndex] |= bit;
+	bitmap->summary[entryIndex / G_BITMAP_BITS_PER_ENTRY] |= 1ULL << (entryIndex % G_BITMAP_BITS_PER_ENTRY);
+	bitmap->freeCount++;
+	return true;
+}
+
+/**
+ * Checks whether all pages in the run are free, comparing whole entries where possible.
+ * The bitmap lock must be held.
+ */
+bool _bitmapPageAllocatorIsRunFree(g_bitmap_header* bitmap, size_t totalBitIndex, size_t count)
+{
+	size_t end = totalBitIndex + count;
+	while(totalBitIndex < end)
+	{
+		size_t entryIndex = totalBitIndex / G_BITMAP_BITS_PER_ENTRY;
+		if(totalBitIndex % G_BITMAP_BITS_PER_ENTRY == 0 && totalBitIndex + G_BITMAP_BITS_PER_ENTRY <= end)
+		{
+			if(bitmap->entries[entryIndex] != ~(G_BITMAP_ENTRY_TYPE) 0)
+				return false;
+			totalBitIndex += G_BITMAP_BITS_PER_ENTRY;
+			continue;
+		}
 
-	return address;
+		if(!(bitmap->entries[entryIndex] & (1ULL << (totalBitIndex % G_BITMAP_BITS_PER_ENTRY))))
+			return false;
+		totalBitIndex++;
+	}
+	return true;
 }
@@ -27,7 +27,13 @@
 
 #include <ghost/stdint.h>
 
-#define G_BITMAP_ALLOCATOR_FASTBUFFER_SIZE 128
+/**
+ * Number of free pages that each processor keeps in its magazine. When the magazine
+ * is full, a batch of pages is given back to the bitmaps; when it is empty, a batch
+ * is taken from them.
+ */
+#define G_BITMAP_ALLOCATOR_MAGAZINE_SIZE    64
+#define G_BITMAP_ALLOCATOR_BATCH            32
 
 #define G_BITMAP_ENTRY_TYPE         uint64_t
 #define G_BITMAP_BITS_PER_ENTRY     (sizeof(G_BITMAP_ENTRY_TYPE) * 8)
@@ -46,6 +52,12 @@ struct g_bitmap_index_page_header
 
 #define G_BITMAP_INDEX_MAX_ENTRIES     ((G_PAGE_SIZE - offsetof(g_bitmap_index_page_header, entries)) / sizeof(g_bitmap_index_page_header))
 
+/**
+ * Number of summary words per bitmap. Bit n of the summary is set when entry n of
+ * the bitmap has any free page, so a free page is found with two bit scans.
+ */
+#define G_BITMAP_SUMMARY_WORDS      8
+
 /**
  * Header of a single bitmap. The entries are the actual bitmap and each address
  * is calculated by the base plus total bit index multiplied by page size.
@@ -55,27 +67,53 @@ struct g_bitmap_header
     g_physical_address base;
     g_physical_address end;
     g_mutex lock;
+
+    /**
+     * Number of free pages in this bitmap, may be read without the lock to skip
+     * bitmaps that have none.
+     */
+    volatile uint32_t freeCount;
+    G_BITMAP_ENTRY_TYPE summary[G_BITMAP_SUMMARY_WORDS];
+
     G_BITMAP_ENTRY_TYPE entries[];
 }__attribute__((packed));
 
 #define G_BITMAP_MAX_ENTRIES                ((G_PAGE_SIZE - offsetof(g_bitmap_header, entries)) / sizeof(G_BITMAP_ENTRY_TYPE))
-#define G_BITMAP_TOTAL_BITS                 (G_BITMAP_MAX_ENTRIES * 8)
+#define G_BITMAP_TOTAL_BITS                 (G_BITMAP_MAX_ENTRIES * G_BITMAP_BITS_PER_ENTRY)
+
+static_assert(G_BITMAP_MAX_ENTRIES <= G_BITMAP_SUMMARY_WORDS * G_BITMAP_BITS_PER_ENTRY,
+              "bitmap summary does not cover all entries");
+
+/**
+ * Free pages that a processor can take without locking.
+ */
+struct g_bitmap_page_magazine
+{
+    g_physical_address pages[G_BITMAP_ALLOCATOR_MAGAZINE_SIZE];
+    uint32_t count;
+};
 
 /**
  * Allocator structure
  */
 struct g_bitmap_page_allocator
 {
-    g_mutex lock;
-    uint32_t freePageCount;
+    /**
+     * Number of pages that are free in the bitmaps, not counting the magazines.
+     */
+    volatile uint32_t freePageCount;
+
+    /**
+     * Bitmaps in the index page are sorted by their base address.
+     */
     g_bitmap_index_page_header* indexPage;
+    uint32_t bitmapCount;
 
-    struct
-    {
-        g_mutex lock;
-        g_physical_address buffer[G_BITMAP_ALLOCATOR_FASTBUFFER_SIZE];
-        int size;
-    } fastBuffer;
+    /**
+     * Processor-local magazines, created once the system is ready.
+     */
+    g_bitmap_page_magazine* volatile magazines;
+    volatile bool magazinesCreating;
 };
 
 /**
@@ -87,5 +125,18 @@ void bitmapPageAllocatorMarkFree(g_bitmap_page_allocator* allocator, g_physical_
 
 g_physical_address bitmapPageAllocatorAllocate(g_bitmap_page_allocator* allocator);
 
+/**
+ * Allocates G_PAGE_LARGE_SIZE / G_PAGE_SIZE consecutive pages that start at a
+ * large page boundary. The pages bypass the magazines and may be freed one by one.
+ *
+ * @return the address of the first page or 0 if there is no such run
+ */
+g_physical_address bitmapPageAllocatorAllocateLarge(g_bitmap_page_allocator* allocator);
+
+/**
+ * @return the number of free pages, including those held in magazines
+ */
+uint32_t bitmapPageAllocatorGetFreePageCount(g_bitmap_page_allocator* allocator);
+
 
 #endif
@@ -53,6 +53,8 @@
 #define G_MEM_HEAP_START                            0xffffff8a00000000
 #define G_MEM_HEAP_INITIAL_SIZE                     0x100000
 #define G_MEM_KERN_HEAP_EXPAND_STEP			    	0x100000
+#define G_MEM_HEAP_SLAB_START                       0xffffff9a00000000
+#define G_MEM_HEAP_SLAB_END                         0xffffffba00000000
 
 
 #endif
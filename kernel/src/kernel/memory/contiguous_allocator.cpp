@@ -0,0 +1,226 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                                                                           *
+ *  Ghost, a micro-kernel based operating system for the x86 architecture    *
+ *  Copyright (C) 2015, Max Schlüssel <lokoxe@gmail.com>                     *
+ *                                                                           *
+ *  This program is free software: you can redistribute it and/or modify     *
+ *  it under the terms of the GNU General Public License as published by     *
+ *  the Free Software Foundation, either version 3 of the License, or        *
+ *  (at your option) any later version.                                      *
+ *                                                                           *
+ *  This program is distributed in the hope that it will be useful,          *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of           *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the            *
+ *  GNU General Public License for more details.                             *
+ *                                                                           *
+ *  You should have received a copy of the GNU General Public License        *
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.    *
+ *                                                                           *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "kernel/memory/contiguous_allocator.hpp"
+#include "kernel/memory/constants.hpp"
+#include "kernel/memory/memory.hpp"
+#include "kernel/system/mutex.hpp"
+#include "kernel/logger/logger.hpp"
+
+#define G_CONTIGUOUS_POOL_ALIGNMENT     (G_PAGE_SIZE << G_CONTIGUOUS_MAX_ORDER)
+#define G_CONTIGUOUS_POOL_LIMIT         0x100000000ULL
+
+/**
+ * State of each page in the pool. Only the first page of a block has a state, the
+ * lower bits hold the order of the block.
+ */
+#define G_CONTIGUOUS_PAGE_INSIDE        0x00
+#define G_CONTIGUOUS_PAGE_FREE          0x40
+#define G_CONTIGUOUS_PAGE_ALLOCATED     0x80
+#define G_CONTIGUOUS_PAGE_ORDER_MASK    0x3F
+
+/**
+ * Free blocks are linked through their own memory.
+ */
+struct g_contiguous_free_block
+{
+	g_contiguous_free_block* next;
+	g_contiguous_free_block* previous;
+};
+
+static g_mutex lock;
+static g_physical_address poolStart = 0;
+static g_physical_address poolEnd = 0;
+static g_contiguous_free_block* freeLists[G_CONTIGUOUS_MAX_ORDER + 1];
+
+/**
+ * The unaligned part in front of the aligned pool is also used, so there may be
+ * up to one largest block more.
+ */
+static uint8_t pageStates[G_CONTIGUOUS_POOL_PAGES + (1 << G_CONTIGUOUS_MAX_ORDER)];
+
+void _contiguousAllocatorPush(g_physical_address block, uint8_t order);
+void _contiguousAllocatorUnlink(g_physical_address block, uint8_t order);
+
+void contiguousAllocatorInitialize(limine_memmap_response* memoryMap)
+{
+	mutexInitializeGlobal(&lock, __func__);
+	for(auto& list: freeLists)
+		list = nullptr;
+
+	g_size poolSize = G_CONTIGUOUS_POOL_PAGES * G_PAGE_SIZE;
+	for(uint64_t i = 0; i < memoryMap->entry_count; i++)
+	{
+		auto entry = memoryMap->entries[i];
+		if(entry->type != LIMINE_MEMMAP_USABLE || entry->base < G_MEM_LOWER_END)
+			continue;
+
+		g_physical_address end = entry->base + entry->length;
+		if(end > G_CONTIGUOUS_POOL_LIMIT)
+			end = G_CONTIGUOUS_POOL_LIMIT;
+
+		g_physical_address alignedStart = G_ALIGN_UP(entry->base, G_CONTIGUOUS_POOL_ALIGNMENT);
+		if(alignedStart + poolSize > end)
+			continue;
+
+		poolStart = entry->base;
+		poolEnd = alignedStart + poolSize;
+		entry->length -= poolEnd - entry->base;
+		entry->base = poolEnd;
+		break;
+	}
+
+	if(poolStart == poolEnd)
+	{
+		logWarn("%! no memory below 4 GiB available for contiguous allocations", "contiguous");
+		return;
+	}
+
+	// Split the pool into the largest blocks that are aligned to their size
+	g_physical_address block = poolStart;
+	while(block < poolEnd)
+	{
+		uint8_t order = G_CONTIGUOUS_MAX_ORDER;
+		while(order > 0 && ((block & ((G_PAGE_SIZE << order) - 1)) || block + (G_PAGE_SIZE << order) > poolEnd))
+			order--;
+
+		_contiguousAllocatorPush(block, order);
+		block += G_PAGE_SIZE << order;
+	}
+
+	logInfo("%! reserved %h - %h for contiguous allocations", "contiguous", poolStart, poolEnd);
+}
+
+bool contiguousAllocatorContains(g_physical_address address)
+{
+	return address >= poolStart && address < poolEnd;
+}
+
+g_physical_address contiguousAllocatorAllocate(uint32_t pages, g_size alignment, g_physical_address limit)
+{
+	if(pages == 0 || alignment > G_CONTIGUOUS_POOL_ALIGNMENT)
+		return 0;
+
+	uint8_t order = 0;
+	while((1U << order) < pages || (G_PAGE_SIZE << order) < alignment)
+	{
+		if(++order > G_CONTIGUOUS_MAX_ORDER)
+			return 0;
+	}
+
+	mutexAcquire(&lock);
+
+	// Find the smallest free block that is large enough and ends below the limit
+	g_physical_address block = 0;
+	uint8_t blockOrder = order;
+	for(; blockOrder <= G_CONTIGUOUS_MAX_ORDER && !block; blockOrder++)
+	{
+		for(auto free = freeLists[blockOrder]; free; free = free->next)
+		{
+			g_physical_address candidate = (g_physical_address) free - G_MEM_HIGHER_HALF_DIRECT_MAP_OFFSET;
+			if(!limit || candidate + (G_PAGE_SIZE << blockOrder) <= limit)
+			{
+				block = candidate;
+				break;
+			}
+		}
+	}
+
+	if(block)
+	{
+		blockOrder--;
+		_contiguousAllocatorUnlink(block, blockOrder);
+
+		// Give back the upper halves until the block has the requested size
+		while(blockOrder > order)
+		{
+			blockOrder--;
+			_contiguousAllocatorPush(block + (G_PAGE_SIZE << blockOrder), blockOrder);
+		}
+		pageStates[(block - poolStart) / G_PAGE_SIZE] = G_CONTIGUOUS_PAGE_ALLOCATED | order;
+	}
+
+	mutexRelease(&lock);
+	return block;
+}
+
+void contiguousAllocatorFree(g_physical_address block)
+{
+	if(!contiguousAllocatorContains(block))
+	{
+		logWarn("%! tried to free %h which is not in the pool", "contiguous", block);
+		return;
+	}
+
+	mutexAcquire(&lock);
+
+	uint8_t state = pageStates[(block - poolStart) / G_PAGE_SIZE];
+	if(!(state & G_CONTIGUOUS_PAGE_ALLOCATED))
+	{
+		mutexRelease(&lock);
+		logWarn("%! tried to free %h which is not an allocated block", "contiguous", block);
+		return;
+	}
+	uint8_t order = state & G_CONTIGUOUS_PAGE_ORDER_MASK;
+	pageStates[(block - poolStart) / G_PAGE_SIZE] = G_CONTIGUOUS_PAGE_INSIDE;
+
+	// Merge with the buddy as long as it is free as a whole
+	while(order < G_CONTIGUOUS_MAX_ORDER)
+	{
+		g_physical_address buddy = block ^ (G_PAGE_SIZE << order);
+		if(!contiguousAllocatorContains(buddy) || buddy + (G_PAGE_SIZE << order) > poolEnd)
+			break;
+		if(pageStates[(buddy - poolStart) / G_PAGE_SIZE] != (G_CONTIGUOUS_PAGE_FREE | order))
+			break;
+
+		_contiguousAllocatorUnlink(buddy, order);
+		if(buddy < block)
+			block = buddy;
+		order++;
+	}
+	_contiguousAllocatorPush(block, order);
+
+	mutexRelease(&lock);
+}
+
+void _contiguousAllocatorPush(g_physical_address block, uint8_t order)
+{
+	auto free = (g_contiguous_free_block*) G_MEM_PHYS_TO_VIRT(block);
+	free->previous = nullptr;
+	free->next = freeLists[order];
+	if(free->next)
+		free->next->previous = free;
+	freeLists[order] = free;
+
+	pageStates[(block - poolStart) / G_PAGE_SIZE] = G_CONTIGUOUS_PAGE_FREE | order;
+}
+
+void _contiguousAllocatorUnlink(g_physical_address block, uint8_t order)
+{
+	auto free = (g_contiguous_free_block*) G_MEM_PHYS_TO_VIRT(block);
+	if(free->previous)
+		free->previous->next = free->next;
+	else
+		freeLists[order] = free->next;
+	if(free->next)
+		free->next->previous = free->previous;
+
+	pageStates[(block - poolStart) / G_PAGE_SIZE] = G_CONTIGUOUS_PAGE_INSIDE;
+}
@@ -0,0 +1,70 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                                                                           *
+ *  Ghost, a micro-kernel based operating system for the x86 architecture    *
+ *  Copyright (C) 2015, Max Schlüssel <lokoxe@gmail.com>                     *
+ *                                                                           *
+ *  This program is free software: you can redistribute it and/or modify     *
+ *  it under the terms of the GNU General Public License as published by     *
+ *  the Free Software Foundation, either version 3 of the License, or        *
+ *  (at your option) any later version.                                      *
+ *                                                                           *
+ *  This program is distributed in the hope that it will be useful,          *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of           *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the            *
+ *  GNU General Public License for more details.                             *
+ *                                                                           *
+ *  You should have received a copy of the GNU General Public License        *
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.    *
+ *                                                                           *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef __KERNEL_CONTIGUOUS_ALLOCATOR__
+#define __KERNEL_CONTIGUOUS_ALLOCATOR__
+
+#include <ghost/memory/types.h>
+#include <limine.h>
+
+/**
+ * Largest block is 2^G_CONTIGUOUS_MAX_ORDER pages (4 MiB), which is also the
+ * largest alignment that can be requested.
+ */
+#define G_CONTIGUOUS_MAX_ORDER      10
+
+/**
+ * Number of pages reserved for contiguous allocations (16 MiB). The pool is taken
+ * from memory below 4 GiB so that devices with 32-bit addressing can use it.
+ */
+#define G_CONTIGUOUS_POOL_PAGES     4096
+
+/**
+ * Reserves the pool for contiguous allocations by cutting it off one of the usable
+ * areas in the memory map. Must be called before the bitmap page allocator is
+ * initialized with the same map.
+ */
+void contiguousAllocatorInitialize(limine_memmap_response* memoryMap);
+
+/**
+ * Allocates physically contiguous pages using a buddy allocator. The block is
+ * rounded up to a power of two pages.
+ *
+ * @param pages
+ * 		number of pages
+ * @param alignment
+ * 		alignment of the physical address in bytes, at most the largest block size
+ * @param limit
+ * 		address that the block must end below, or 0 for none
+ * @return the physical address or 0 if no suitable block is free
+ */
+g_physical_address contiguousAllocatorAllocate(uint32_t pages, g_size alignment, g_physical_address limit);
+
+/**
+ * Frees a block that was allocated with <contiguousAllocatorAllocate>.
+ */
+void contiguousAllocatorFree(g_physical_address block);
+
+/**
+ * @return whether the address lies in the pool of contiguous memory
+ */
+bool contiguousAllocatorContains(g_physical_address address);
+
+#endif
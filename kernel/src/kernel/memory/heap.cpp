@@ -25,6 +25,9 @@
 #include "kernel/memory/constants.hpp"
 #include "kernel/panic.hpp"
 #include "kernel/system/mutex.hpp"
+#include "kernel/system/interrupts/interrupts.hpp"
+#include "kernel/system/processor/processor.hpp"
+#include "kernel/system/system.hpp"
 
 static g_allocator heapAllocator;
 static g_virtual_address heapStart = 0;
@@ -34,8 +37,36 @@ static bool heapInitialized = false;
 
 static g_mutex heapLock;
 
+/**
+ * Object sizes of the slab classes. Each class is at most 25% larger than the
+ * previous one, which bounds the internal fragmentation of small allocations.
+ */
+static g_heap_size_class heapSizeClasses[G_HEAP_SIZE_CLASS_COUNT] = {
+		{16}, {32}, {48}, {64}, {80}, {96}, {128}, {160}, {192}, {256}, {320}, {384},
+		{512}, {640}, {768}, {1024}, {1280}, {1536}, {2048}};
+
+/**
+ * Lookup from size in 16-byte steps to the size class index.
+ */
+static uint8_t heapSizeClassLookup[G_HEAP_SLAB_MAX_OBJECT / 16 + 1];
+
+static g_virtual_address heapSlabEnd = G_MEM_HEAP_SLAB_START;
+static g_heap_slab* heapEmptySlabs = nullptr;
+
+static g_heap_local* heapLocals = nullptr;
+
 bool _heapExpand();
 void _heapMapInitialArea();
+void* _heapAllocateLocked(uint32_t size);
+g_heap_local* _heapGetLocal();
+void _heapCacheRefill(g_heap_cache* cache, uint8_t sizeClass);
+void _heapCacheFlush(g_heap_cache* cache);
+void* _heapSlabAllocate(uint8_t sizeClass);
+void _heapSlabFree(void* ptr);
+g_heap_slab* _heapSlabCreate();
+void _heapSlabInitialize(g_heap_slab* slab, uint8_t sizeClass);
+void _heapSlabUnlink(g_heap_slab** list, g_heap_slab* slab);
+void _heapSlabPush(g_heap_slab** list, g_heap_slab* slab);
 
 void heapInitialize()
 {
@@ -46,6 +77,14 @@ void heapInitialize()
 	mutexInitializeGlobal(&heapLock, __func__);
 	memoryAllocatorInitialize(&heapAllocator, G_ALLOCATOR_TYPE_HEAP, heapStart, heapEnd);
 
+	uint8_t sizeClass = 0;
+	for(uint32_t i = 0; i < sizeof(heapSizeClassLookup); i++)
+	{
+		while(heapSizeClasses[sizeClass].size < i * 16)
+			++sizeClass;
+		heapSizeClassLookup[i] = sizeClass;
+	}
+
 	logDebug("%! initialized with area: %h - %h", "heap", heapStart, heapEnd);
 	heapInitialized = true;
 }
@@ -66,29 +105,126 @@ void _heapMapInitialArea()
 
 void* heapAllocate(uint32_t size)
 {
-	mutexAcquire(&heapLock);
-
 	if(!heapInitialized)
 		panic("%! tried to use uninitialized kernel heap", "kernheap");
 
-	void* ptr = memoryAllocatorAllocate(&heapAllocator, size);
-	if(!ptr)
+	if(size <= G_HEAP_SLAB_MAX_OBJECT)
 	{
-		if(_heapExpand())
+		INTERRUPTS_PAUSE;
+		g_heap_local* local = _heapGetLocal();
+		if(local)
 		{
-			mutexRelease(&heapLock);
-			return heapAllocate(size);
+			uint8_t sizeClass = heapSizeClassLookup[(size + 15) / 16];
+			g_heap_cache* cache = &local->caches[sizeClass];
+			if(!cache->objects)
+				_heapCacheRefill(cache, sizeClass);
+
+			g_heap_slab_object* object = cache->objects;
+			cache->objects = object->next;
+			cache->count--;
+			local->amountInUse += heapSizeClasses[sizeClass].size;
+
+			INTERRUPTS_RESUME;
+			return object;
 		}
+		INTERRUPTS_RESUME;
+	}
+
+	mutexAcquire(&heapLock);
+	void* ptr = _heapAllocateLocked(size);
+	mutexRelease(&heapLock);
+	return ptr;
+}
+
+/**
+ * Allocates directly from the slabs or the chunk allocator. The heap lock must be held.
+ */
+void* _heapAllocateLocked(uint32_t size)
+{
+	if(size <= G_HEAP_SLAB_MAX_OBJECT)
+	{
+		uint8_t sizeClass = heapSizeClassLookup[(size + 15) / 16];
+		heapAmountInUse += heapSizeClasses[sizeClass].size;
+		return _heapSlabAllocate(sizeClass);
+	}
+
+	void* ptr;
+	while(!(ptr = memoryAllocatorAllocate(&heapAllocator, size)))
+	{
+		if(!_heapExpand())
+		{
+			panic("%! failed to allocate kernel memory", "kernheap");
+			return nullptr;
+		}
+	}
+
+	auto section = ((g_allocator_section_header*) ptr) - 1;
+	heapAmountInUse += section->totalSize - sizeof(g_allocator_section_header);
+	return ptr;
+}
 
-		panic("%! failed to allocate kernel memory", "kernheap");
+/**
+ * Returns the heap state of the current processor. Until the system is ready, the
+ * number of processors is not final, so the shared path is used instead. Interrupts
+ * must be disabled.
+ *
+ * @return the local state or null if it can't be used yet
+ */
+g_heap_local* _heapGetLocal()
+{
+	if(!systemIsReady())
 		return nullptr;
+
+	if(!heapLocals)
+	{
+		mutexAcquire(&heapLock);
+		if(!heapLocals)
+		{
+			uint32_t size = sizeof(g_heap_local) * processorGetNumberOfProcessors();
+			auto locals = (g_heap_local*) _heapAllocateLocked(size);
+			memorySetBytes(locals, 0, size);
+			heapLocals = locals;
+		}
+		mutexRelease(&heapLock);
 	}
+	return &heapLocals[processorGetCurrentId()];
+}
 
-	heapAmountInUse += size;
+/**
+ * Moves a batch of objects from the slabs to the cache of the processor.
+ */
+void _heapCacheRefill(g_heap_cache* cache, uint8_t sizeClass)
+{
+	mutexAcquire(&heapLock);
+
+	for(uint32_t i = 0; i < G_HEAP_CACHE_BATCH; i++)
+	{
+		auto object = (g_heap_slab_object*) _heapSlabAllocate(sizeClass);
+		object->next = cache->objects;
+		cache->objects = object;
+		cache->count++;
+	}
 
 	mutexRelease(&heapLock);
+}
 
-	return ptr;
+/**
+ * Gives half of the objects of the processor cache back to their slabs.
+ */
+void _heapCacheFlush(g_heap_cache* cache)
+{
+	mutexAcquire(&heapLock);
+
+	for(uint32_t i = 0; i < G_HEAP_CACHE_LIMIT / 2; i++)
+	{
+		g_heap_slab_object* object = cache->objects;
+		cache->objects = object->next;
+		cache->count--;
+
+		_heapSlabFree(object);
+	}
+
+	mutexRelease(&heapLock);
 }
 
 void* heapAllocateClear(uint32_t size)
@@ -109,16 +245,51 @@ void heapFree(void* ptr)
 		return;
 	}
 
-	mutexAcquire(&heapLock);
+	if((g_virtual_address) ptr >= G_MEM_HEAP_SLAB_START && (g_virtual_address) ptr < G_MEM_HEAP_SLAB_END)
+	{
+		auto slab = (g_heap_slab*) G_ALIGN_DOWN((g_virtual_address) ptr, G_HEAP_SLAB_SIZE);
+		uint8_t sizeClass = slab->sizeClass;
 
-	heapAmountInUse -= memoryAllocatorFree(&heapAllocator, ptr);
+		INTERRUPTS_PAUSE;
+		g_heap_local* local = _heapGetLocal();
+		if(local)
+		{
+			g_heap_cache* cache = &local->caches[sizeClass];
+			auto object = (g_heap_slab_object*) ptr;
+			object->next = cache->objects;
+			cache->objects = object;
+			cache->count++;
+			local->amountInUse -= heapSizeClasses[sizeClass].size;
+
+			if(cache->count > G_HEAP_CACHE_LIMIT)
+				_heapCacheFlush(cache);
+
+			INTERRUPTS_RESUME;
+			return;
+		}
+		INTERRUPTS_RESUME;
 
+		mutexAcquire(&heapLock);
+		heapAmountInUse -= heapSizeClasses[sizeClass].size;
+		_heapSlabFree(ptr);
+		mutexRelease(&heapLock);
+		return;
+	}
+
+	mutexAcquire(&heapLock);
+	heapAmountInUse -= memoryAllocatorFree(&heapAllocator, ptr);
 	mutexRelease(&heapLock);
 }
 
 uint32_t heapGetUsedAmount()
 {
-	return heapAmountInUse;
+	int64_t amount = heapAmountInUse;
+	if(heapLocals)
+	{
+		for(uint32_t i = 0; i < processorGetNumberOfProcessors(); i++)
+			amount += heapLocals[i].amountInUse;
+	}
+	return amount;
 }
 
 bool _heapExpand()
@@ -142,3 +313,130 @@ bool _heapExpand()
 
 	return true;
 }
+
+/**
+ * Takes an object of the size class from its slabs. The heap lock must be held.
+ */
+void* _heapSlabAllocate(uint8_t sizeClass)
+{
+	g_heap_size_class* cls = &heapSizeClasses[sizeClass];
+
+	g_heap_slab* slab = cls->partial;
+	if(!slab)
+	{
+		slab = heapEmptySlabs;
+		if(slab)
+			_heapSlabUnlink(&heapEmptySlabs, slab);
+		else
+			slab = _heapSlabCreate();
+
+		if(!slab)
+		{
+			panic("%! failed to allocate kernel memory", "kernheap");
+			return nullptr;
+		}
+
+		_heapSlabInitialize(slab, sizeClass);
+		_heapSlabPush(&cls->partial, slab);
+	}
+
+	g_heap_slab_object* object = slab->freeObjects;
+	slab->freeObjects = object->next;
+	if(++slab->used == slab->capacity)
+		_heapSlabUnlink(&cls->partial, slab);
+
+	return object;
+}
+
+/**
+ * Returns an object to its slab. The heap lock must be held.
+ */
+void _heapSlabFree(void* ptr)
+{
+	auto slab = (g_heap_slab*) G_ALIGN_DOWN((g_virtual_address) ptr, G_HEAP_SLAB_SIZE);
+	g_heap_size_class* cls = &heapSizeClasses[slab->sizeClass];
+
+	if(slab->used == 0 || ((g_virtual_address) ptr - (g_virtual_address) slab) < sizeof(g_heap_slab))
+		panic("%! tried to free invalid slab object %h", "kernheap", ptr);
+
+	if(slab->used == slab->capacity)
+		_heapSlabPush(&cls->partial, slab);
+
+	auto object = (g_heap_slab_object*) ptr;
+	object->next = slab->freeObjects;
+	slab->freeObjects = object;
+
+	// Keep the last partial slab of a class to avoid reinitializing it on every allocation
+	if(--slab->used == 0 && (cls->partial != slab || slab->next))
+	{
+		_heapSlabUnlink(&cls->partial, slab);
+		_heapSlabPush(&heapEmptySlabs, slab);
+	}
+}
+
+g_heap_slab* _heapSlabCreate()
+{
+	// Claim the area first, mapping pages may itself allocate from the heap
+	g_virtual_address slabStart = heapSlabEnd;
+	if(slabStart + G_HEAP_SLAB_SIZE > G_MEM_HEAP_SLAB_END)
+	{
+		logWarn("%! slab area is exhausted", "kernheap");
+		return nullptr;
+	}
+	heapSlabEnd += G_HEAP_SLAB_SIZE;
+
+	for(g_virtual_address virt = slabStart; virt < slabStart + G_HEAP_SLAB_SIZE; virt += G_PAGE_SIZE)
+	{
+		g_physical_address phys = memoryPhysicalAllocate(true);
+		if(phys == 0)
+		{
+			logWarn("%! failed to create slab, out of physical memory", "kernheap");
+			return nullptr;
+		}
+
+		pagingMapPage(virt, phys, G_PAGE_TABLE_KERNEL_DEFAULT, G_PAGE_KERNEL_DEFAULT);
+	}
+
+	return (g_heap_slab*) slabStart;
+}
+
+void _heapSlabInitialize(g_heap_slab* slab, uint8_t sizeClass)
+{
+	uint32_t objectSize = heapSizeClasses[sizeClass].size;
+	g_virtual_address first = G_ALIGN_UP((g_virtual_address) slab + sizeof(g_heap_slab), 16);
+	uint16_t capacity = ((g_virtual_address) slab + G_HEAP_SLAB_SIZE - first) / objectSize;
+
+	slab->sizeClass = sizeClass;
+	slab->used = 0;
+	slab->capacity = capacity;
+	slab->freeObjects = nullptr;
+	for(uint16_t i = capacity; i > 0; i--)
+	{
+		auto object = (g_heap_slab_object*) (first + (i - 1) * objectSize);
+		object->next = slab->freeObjects;
+		slab->freeObjects = object;
+	}
+}
+
+void _heapSlabUnlink(g_heap_slab** list, g_heap_slab* slab)
+{
+	if(slab->previous)
+		slab->previous->next = slab->next;
+	else
+		*list = slab->next;
+
+	if(slab->next)
+		slab->next->previous = slab->previous;
+
+	slab->next = nullptr;
+	slab->previous = nullptr;
+}
+
+void _heapSlabPush(g_heap_slab** list, g_heap_slab* slab)
+{
+	slab->previous = nullptr;
+	slab->next = *list;
+	if(*list)
+		(*list)->previous = slab;
+	*list = slab;
+}
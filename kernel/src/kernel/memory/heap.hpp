@@ -24,13 +24,83 @@
 #include <ghost/memory/types.h>
 
 /**
- * Initializes the kernel heap. This maps an initial memory area and
- * then performs an initialization of a memory allocator on this area.
+ * Small allocations are served from slabs. A slab is a naturally aligned block of
+ * memory that starts with a header and is divided into objects of one size class,
+ * so the slab that owns an object is found by aligning its address down.
+ */
+#define G_HEAP_SLAB_SIZE 0x4000
+#define G_HEAP_SLAB_MAX_OBJECT 2048
+#define G_HEAP_SIZE_CLASS_COUNT 19
+
+/**
+ * Each processor caches free objects of every size class. A cache is refilled from
+ * the slabs in batches and gives half of its objects back once it exceeds its limit.
+ */
+#define G_HEAP_CACHE_BATCH 16
+#define G_HEAP_CACHE_LIMIT 32
+
+/**
+ * Link within a free object of a slab.
+ */
+struct g_heap_slab_object
+{
+    g_heap_slab_object* next;
+};
+
+/**
+ * Header at the start of each slab.
+ */
+struct g_heap_slab
+{
+    g_heap_slab* next;
+    g_heap_slab* previous;
+    g_heap_slab_object* freeObjects;
+    uint16_t sizeClass;
+    uint16_t used;
+    uint16_t capacity;
+};
+
+/**
+ * A size class keeps a list of its slabs that have at least one free object.
+ */
+struct g_heap_size_class
+{
+    uint32_t size;
+    g_heap_slab* partial;
+};
+
+/**
+ * Free objects of one size class held by a processor.
+ */
+struct g_heap_cache
+{
+    g_heap_slab_object* objects;
+    uint32_t count;
+};
+
+/**
+ * Heap state of a processor. Objects are freed to the cache of the processor that
+ * frees them, regardless of which one allocated them; they only go back to their
+ * slab when that cache is flushed.
+ */
+struct g_heap_local
+{
+    g_heap_cache caches[G_HEAP_SIZE_CLASS_COUNT];
+    int64_t amountInUse;
+};
+
+/**
+ * Initializes the kernel heap. This maps an initial memory area for large
+ * allocations and initializes a memory allocator on it. Slabs for small
+ * allocations are mapped on demand in their own area.
  */
 void heapInitialize();
 
 /**
- * Allocates a number of bytes on the kernel heap.
+ * Allocates a number of bytes on the kernel heap. Requests of up to
+ * G_HEAP_SLAB_MAX_OBJECT bytes are rounded up to the next size class and
+ * taken from the cache of the current processor without locking, larger
+ * requests are placed in the chunk allocator.
  *
  * Causes a panic if it fails.
  */
@@ -44,7 +114,8 @@ void* heapAllocate(uint32_t size);
 void* heapAllocateClear(uint32_t size);
 
 /**
- * Frees the given range.
+ * Frees the given range. Objects within the slab area are put into the
+ * cache of the current processor in constant time.
  */
 void heapFree(void* memory);
 
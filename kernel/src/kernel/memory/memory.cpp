@@ -24,20 +24,24 @@
 #include "kernel/kernel.hpp"
 #include "kernel/memory/heap.hpp"
 #include "kernel/memory/constants.hpp"
+#include "kernel/memory/contiguous_allocator.hpp"
 #include "kernel/memory/page_reference_tracker.hpp"
 #include "kernel/memory/paging.hpp"
 #include "kernel/tasking/task.hpp"
 #include "kernel/logger/logger.hpp"
+#include "kernel/system/interrupts/interrupts.hpp"
 
 g_address_range_pool* memoryVirtualRangePool = nullptr;
 g_bitmap_page_allocator memoryPhysicalAllocator;
+g_mutex memoryCopyOnWriteLock;
 
 void memoryInitialize(limine_memmap_response* memoryMap)
 {
 	logInfo("%! initializing kernel memory with map at %x", "mem", memoryMap);
 
+	contiguousAllocatorInitialize(memoryMap);
 	bitmapPageAllocatorInitialize(&memoryPhysicalAllocator, memoryMap);
-	logInfo("%! available: %i MiB", "memory", (memoryPhysicalAllocator.freePageCount * G_PAGE_SIZE) / 1024 / 1024);
+	logInfo("%! available: %i MiB", "memory", (bitmapPageAllocatorGetFreePageCount(&memoryPhysicalAllocator) * G_PAGE_SIZE) / 1024 / 1024);
 
 	heapInitialize();
 
@@ -46,6 +50,7 @@ void memoryInitialize(limine_memmap_response* memoryMap)
 	addressRangePoolAddRange(memoryVirtualRangePool, G_MEM_KERN_VIRT_RANGES_START, G_MEM_KERN_VIRT_RANGES_END);
 
 	pageReferenceTrackerInitialize();
+	mutexInitializeGlobal(&memoryCopyOnWriteLock, __func__);
 }
 
 g_physical_address memoryPhysicalAllocate(bool untracked)
@@ -56,6 +61,17 @@ g_physical_address memoryPhysicalAllocate(bool untracked)
 	return page;
 }
 
+g_physical_address memoryPhysicalAllocateLarge()
+{
+	g_physical_address base = bitmapPageAllocatorAllocateLarge(&memoryPhysicalAllocator);
+	if(base)
+	{
+		for(g_physical_address page = base; page < base + G_PAGE_LARGE_SIZE; page += G_PAGE_SIZE)
+			pageReferenceTrackerIncrement(page);
+	}
+	return base;
+}
+
 void memoryPhysicalFree(g_physical_address page)
 {
 	if(!page)
@@ -211,3 +227,60 @@ void* memoryCopy(void* target, const void* source, int32_t size)
 
 	return target;
 }
+
+bool memoryCopyOnWriteHandlePageFault(g_task* task, g_address accessed)
+{
+	g_virtual_address page = G_PAGE_ALIGN_DOWN(accessed);
+	bool resolved = false;
+	bool replaced = false;
+
+	mutexAcquire(&memoryCopyOnWriteLock);
+
+	uint64_t entry = pagingVirtualToPageEntry(page);
+	if((entry & G_PAGE_PRESENT) && (entry & G_PAGE_USER_FLAG))
+	{
+		uint64_t flags = entry & G_PAGE_ALIGN_MASK;
+
+		if(entry & G_PAGE_WRITABLE_FLAG)
+		{
+			// Another processor already resolved it, our TLB entry was stale
+			pagingInvalidatePage(page);
+			resolved = true;
+		}
+		else if(entry & G_PAGE_COPY_ON_WRITE_FLAG)
+		{
+			g_physical_address shared = entry & ~G_PAGE_ALIGN_MASK;
+			flags = (flags | G_PAGE_WRITABLE_FLAG) & ~G_PAGE_COPY_ON_WRITE_FLAG;
+
+			if(pageReferenceTrackerGet(shared) > 1)
+			{
+				g_physical_address copy = memoryPhysicalAllocate();
+				if(copy)
+				{
+					memoryCopy((void*) G_MEM_PHYS_TO_VIRT(copy), (void*) G_MEM_PHYS_TO_VIRT(shared), G_PAGE_SIZE);
+					pagingMapPage(page, copy, G_PAGE_TABLE_USER_DEFAULT, flags, true);
+					memoryPhysicalFree(shared);
+					resolved = true;
+					replaced = true;
+				}
+				else
+				{
+					logWarn("%! out of memory while copying page %h for task %i", "cow", page, task->id);
+				}
+			}
+			else
+			{
+				pagingMapPage(page, shared, G_PAGE_TABLE_USER_DEFAULT, flags, true);
+				resolved = true;
+			}
+		}
+	}
+
+	mutexRelease(&memoryCopyOnWriteLock);
+
+	// Other threads of the process may still read the old page through their TLB
+	if(replaced)
+		interruptsSendTlbFlush(task->process->pageSpace);
+
+	return resolved;
+}
@@ -28,6 +28,7 @@
 #include "kernel/filesystem/filesystem.hpp"
 #include "kernel/memory/address_range_pool.hpp"
 #include "kernel/memory/bitmap_page_allocator.hpp"
+#include "kernel/system/mutex.hpp"
 
 #define G_ALIGN_UP(value, boundary)    (((value) + ((boundary) - 1)) & ~((boundary) - 1))
 #define G_ALIGN_DOWN(value, boundary)  ((value) & ~((boundary) - 1))
@@ -37,6 +38,11 @@ class g_process;
 
 extern g_address_range_pool* memoryVirtualRangePool;
 
+/**
+ * Lock that must be held while copy-on-write entries are created or resolved.
+ */
+extern g_mutex memoryCopyOnWriteLock;
+
 void memoryInitialize(limine_memmap_response* memoryMap);
 
 /**
@@ -44,6 +50,14 @@ void memoryInitialize(limine_memmap_response* memoryMap);
  */
 g_physical_address memoryPhysicalAllocate(bool untracked = false);
 
+/**
+ * Allocates physical memory for a large page. Each of the contained pages is
+ * tracked on its own, so they can be freed one by one with memoryPhysicalFree.
+ *
+ * @return the physical address or 0 if no aligned run of free pages exists
+ */
+g_physical_address memoryPhysicalAllocateLarge();
+
 /**
  * Frees a physical memory page.
  */
@@ -75,6 +89,16 @@ g_memory_file_ondemand* memoryOnDemandFindMapping(g_task* task, g_address addres
  */
 bool memoryOnDemandHandlePageFault(g_task* task, g_address accessed);
 
+/**
+ * Handles a write to a copy-on-write page in the current address space. If the
+ * physical page is still referenced elsewhere, it is copied, otherwise the page
+ * is simply made writable again. A copied page is shot down on all processors
+ * that run the process, so the copy-on-write lock must not be held by the caller.
+ *
+ * @return whether the fault was resolved
+ */
+bool memoryCopyOnWriteHandlePageFault(g_task* task, g_address accessed);
+
 /**
  * Reference to the loaders or kernels physical page allocator.
  */
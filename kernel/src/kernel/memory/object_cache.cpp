@@ -0,0 +1,190 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                                                                           *
+ *  Ghost, a micro-kernel based operating system for the x86 architecture    *
+ *  Copyright (C) 2015, Max Schlüssel <lokoxe@gmail.com>                     *
+ *                                                                           *
+ *  This program is free software: you can redistribute it and/or modify     *
+ *  it under the terms of the GNU General Public License as published by     *
+ *  the Free Software Foundation, either version 3 of the License, or        *
+ *  (at your option) any later version.                                      *
+ *                                                                           *
+ *  This program is distributed in the hope that it will be useful,          *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of           *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the            *
+ *  GNU General Public License for more details.                             *
+ *                                                                           *
+ *  You should have received a copy of the GNU General Public License        *
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.    *
+ *                                                                           *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "kernel/memory/object_cache.hpp"
+#include "kernel/memory/heap.hpp"
+#include "kernel/memory/memory.hpp"
+#include "kernel/system/interrupts/interrupts.hpp"
+#include "kernel/system/processor/processor.hpp"
+#include "kernel/system/system.hpp"
+
+void _objectCacheGrow(g_object_cache* cache);
+void _objectCacheRefill(g_object_cache* cache, g_object_cache_local* local);
+void _objectCacheFlush(g_object_cache* cache, g_object_cache_local* local);
+
+/**
+ * @return the size of each object in memory, large enough to link it while free
+ */
+uint32_t _objectCacheGetStride(g_object_cache* cache)
+{
+	uint32_t size = cache->objectSize < sizeof(g_object_cache_free) ? sizeof(g_object_cache_free) : cache->objectSize;
+	return G_ALIGN_UP(size, sizeof(g_address));
+}
+
+/**
+ * Returns the list of the current processor. Until the system is ready, the number of
+ * processors is not final and reading the processor id is slow, so the shared list
+ * is used instead. Interrupts must be disabled.
+ *
+ * @return the list or null if it can't be used yet
+ */
+g_object_cache_local* _objectCacheGetLocal(g_object_cache* cache)
+{
+	if(!systemIsReady())
+		return nullptr;
+
+	if(!cache->locals)
+	{
+		G_SPINLOCK_ACQUIRE(cache->lock);
+		if(!cache->locals)
+			cache->locals = (g_object_cache_local*) heapAllocateClear(
+					sizeof(g_object_cache_local) * processorGetNumberOfProcessors());
+		G_SPINLOCK_RELEASE(cache->lock);
+	}
+	return &cache->locals[processorGetCurrentId()];
+}
+
+void* objectCacheAllocate(g_object_cache* cache)
+{
+	INTERRUPTS_PAUSE;
+
+	g_object_cache_free* object;
+	g_object_cache_local* local = _objectCacheGetLocal(cache);
+	if(local)
+	{
+		if(!local->objects)
+			_objectCacheRefill(cache, local);
+
+		object = local->objects;
+		local->objects = object->next;
+		local->count--;
+	}
+	else
+	{
+		G_SPINLOCK_ACQUIRE(cache->lock);
+		if(!cache->shared)
+			_objectCacheGrow(cache);
+
+		object = cache->shared;
+		cache->shared = object->next;
+		cache->sharedCount--;
+		G_SPINLOCK_RELEASE(cache->lock);
+	}
+
+	INTERRUPTS_RESUME;
+	return object;
+}
+
+void* objectCacheAllocateClear(g_object_cache* cache)
+{
+	void* object = objectCacheAllocate(cache);
+	memorySetBytes(object, 0, cache->objectSize);
+	return object;
+}
+
+void objectCacheFree(g_object_cache* cache, void* memory)
+{
+	INTERRUPTS_PAUSE;
+
+	auto object = (g_object_cache_free*) memory;
+	g_object_cache_local* local = _objectCacheGetLocal(cache);
+	if(local)
+	{
+		object->next = local->objects;
+		local->objects = object;
+		local->count++;
+
+		if(local->count > G_OBJECT_CACHE_LOCAL_LIMIT)
+			_objectCacheFlush(cache, local);
+	}
+	else
+	{
+		G_SPINLOCK_ACQUIRE(cache->lock);
+		object->next = cache->shared;
+		cache->shared = object;
+		cache->sharedCount++;
+		G_SPINLOCK_RELEASE(cache->lock);
+	}
+
+	INTERRUPTS_RESUME;
+}
+
+/**
+ * Allocates a batch of objects from the heap and adds them to the shared list.
+ * The cache lock must be held.
+ */
+void _objectCacheGrow(g_object_cache* cache)
+{
+	uint32_t stride = _objectCacheGetStride(cache);
+	auto memory = (uint8_t*) heapAllocate(stride * G_OBJECT_CACHE_BATCH);
+
+	for(uint32_t i = 0; i < G_OBJECT_CACHE_BATCH; i++)
+	{
+		auto object = (g_object_cache_free*) (memory + i * stride);
+		object->next = cache->shared;
+		cache->shared = object;
+	}
+	cache->sharedCount += G_OBJECT_CACHE_BATCH;
+}
+
+/**
+ * Moves a batch of objects from the shared list to the list of the processor.
+ */
+void _objectCacheRefill(g_object_cache* cache, g_object_cache_local* local)
+{
+	G_SPINLOCK_ACQUIRE(cache->lock);
+
+	if(!cache->shared)
+		_objectCacheGrow(cache);
+
+	for(uint32_t i = 0; i < G_OBJECT_CACHE_BATCH && cache->shared; i++)
+	{
+		g_object_cache_free* object = cache->shared;
+		cache->shared = object->next;
+		cache->sharedCount--;
+
+		object->next = local->objects;
+		local->objects = object;
+		local->count++;
+	}
+
+	G_SPINLOCK_RELEASE(cache->lock);
+}
+
+/**
+ * Gives half of the objects of the processor list back to the shared list.
+ */
+void _objectCacheFlush(g_object_cache* cache, g_object_cache_local* local)
+{
+	G_SPINLOCK_ACQUIRE(cache->lock);
+
+	for(uint32_t i = 0; i < G_OBJECT_CACHE_LOCAL_LIMIT / 2; i++)
+	{
+		g_object_cache_free* object = local->objects;
+		local->objects = object->next;
+		local->count--;
+
+		object->next = cache->shared;
+		cache->shared = object;
+		cache->sharedCount++;
+	}
+
+	G_SPINLOCK_RELEASE(cache->lock);
+}
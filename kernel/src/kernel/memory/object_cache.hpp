@@ -0,0 +1,96 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                                                                           *
+ *  Ghost, a micro-kernel based operating system for the x86 architecture    *
+ *  Copyright (C) 2015, Max Schlüssel <lokoxe@gmail.com>                     *
+ *                                                                           *
+ *  This program is free software: you can redistribute it and/or modify     *
+ *  it under the terms of the GNU General Public License as published by     *
+ *  the Free Software Foundation, either version 3 of the License, or        *
+ *  (at your option) any later version.                                      *
+ *                                                                           *
+ *  This program is distributed in the hope that it will be useful,          *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of           *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the            *
+ *  GNU General Public License for more details.                             *
+ *                                                                           *
+ *  You should have received a copy of the GNU General Public License        *
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.    *
+ *                                                                           *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef __KERNEL_OBJECT_CACHE__
+#define __KERNEL_OBJECT_CACHE__
+
+#include "kernel/system/spinlock.hpp"
+#include <ghost/memory/types.h>
+
+/**
+ * Number of free objects that a processor keeps in its own list. When there are
+ * more, half of them are given back to the shared list of the cache.
+ */
+#define G_OBJECT_CACHE_LOCAL_LIMIT  32
+
+/**
+ * Number of objects that are moved between the shared and a processor list at
+ * once, and that are allocated from the heap at once when the cache runs empty.
+ */
+#define G_OBJECT_CACHE_BATCH        16
+
+/**
+ * Free objects are linked through their first bytes.
+ */
+struct g_object_cache_free
+{
+	g_object_cache_free* next;
+};
+
+struct g_object_cache_local
+{
+	g_object_cache_free* objects;
+	uint32_t count;
+};
+
+/**
+ * Cache for objects of a fixed size. Each processor takes objects from its own list
+ * without locking; only when this runs empty or full, a batch is exchanged with the
+ * shared list. Memory of freed objects is kept in the cache and not given back to
+ * the heap.
+ *
+ * Caches are defined statically with <G_OBJECT_CACHE_INITIALIZER> and need no
+ * further initialization. Objects must only be freed to the cache they came from.
+ */
+struct g_object_cache
+{
+	const char* name;
+	uint32_t objectSize;
+
+	g_spinlock lock;
+	g_object_cache_free* shared;
+	uint32_t sharedCount;
+
+	/**
+	 * Processor-local lists, created once the system is ready.
+	 */
+	g_object_cache_local* volatile locals;
+};
+
+#define G_OBJECT_CACHE_INITIALIZER(name, type) {name, sizeof(type), 0, nullptr, 0, nullptr}
+
+/**
+ * Takes an object from the cache.
+ *
+ * Causes a panic if it fails.
+ */
+void* objectCacheAllocate(g_object_cache* cache);
+
+/**
+ * Takes an object from the cache and clears it.
+ */
+void* objectCacheAllocateClear(g_object_cache* cache);
+
+/**
+ * Gives an object back to the cache.
+ */
+void objectCacheFree(g_object_cache* cache, void* object);
+
+#endif
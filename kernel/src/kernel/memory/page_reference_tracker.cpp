@@ -25,10 +25,6 @@
 static g_pp_reference_count_directory directory;
 static g_mutex lock;
 
-#if __x86_64__
-#warning "This class does not support 64 bits"
-#endif
-
 void pageReferenceTrackerInitialize()
 {
 	mutexInitializeGlobal(&lock, __func__);
@@ -36,6 +32,9 @@ void pageReferenceTrackerInitialize()
 
 void pageReferenceTrackerIncrement(g_physical_address address)
 {
+	if(!pageReferenceTrackerIsTracked(address))
+		return;
+
 	mutexAcquire(&lock);
 
 	uint32_t ti = G_TABLE_IN_DIRECTORY_INDEX(address);
@@ -58,6 +57,9 @@ void pageReferenceTrackerIncrement(g_physical_address address)
 
 int16_t pageReferenceTrackerDecrement(g_physical_address address)
 {
+	if(!pageReferenceTrackerIsTracked(address))
+		return 0;
+
 	mutexAcquire(&lock);
 
 	uint32_t ti = G_TABLE_IN_DIRECTORY_INDEX(address);
@@ -74,3 +76,24 @@ int16_t pageReferenceTrackerDecrement(g_physical_address address)
 
 	return refs < 0 ? 0 : refs;
 }
+
+int16_t pageReferenceTrackerGet(g_physical_address address)
+{
+	if(!pageReferenceTrackerIsTracked(address))
+		return 0;
+
+	mutexAcquire(&lock);
+
+	uint32_t ti = G_TABLE_IN_DIRECTORY_INDEX(address);
+	uint32_t pi = G_PAGE_IN_TABLE_INDEX(address);
+
+	int16_t refs = directory.tables[ti] ? directory.tables[ti]->referenceCount[pi] : 0;
+	mutexRelease(&lock);
+
+	return refs < 0 ? 0 : refs;
+}
+
+bool pageReferenceTrackerIsTracked(g_physical_address address)
+{
+	return G_TABLE_IN_DIRECTORY_INDEX(address) < G_PP_REFERENCE_COUNT_TABLES;
+}
@@ -24,6 +24,12 @@
 #include <ghost/stdint.h>
 #include <ghost/memory/types.h>
 
+/**
+ * Number of tables in the directory. Each table counts the references of 1024 pages,
+ * so this covers the first 64 GiB of physical memory.
+ */
+#define G_PP_REFERENCE_COUNT_TABLES 16384
+
 /**
  *
  */
@@ -37,7 +43,7 @@ struct g_pp_reference_count_table
  */
 struct g_pp_reference_count_directory
 {
-	g_pp_reference_count_table* tables[1024];
+	g_pp_reference_count_table* tables[G_PP_REFERENCE_COUNT_TABLES];
 };
 
 void pageReferenceTrackerInitialize();
@@ -54,4 +60,14 @@ void pageReferenceTrackerIncrement(g_physical_address address);
  */
 int16_t pageReferenceTrackerDecrement(g_physical_address address);
 
+/**
+ * @return the number of references on a physical page
+ */
+int16_t pageReferenceTrackerGet(g_physical_address address);
+
+/**
+ * @return whether references on this physical page can be counted
+ */
+bool pageReferenceTrackerIsTracked(g_physical_address address);
+
 #endif
@@ -24,6 +24,9 @@
 #include "kernel/memory/memory.hpp"
 #include "kernel/panic.hpp"
 
+volatile uint64_t* _pagingGetPageDirectory(g_virtual_address virt, uint64_t pdptFlags, uint64_t pdFlags, bool create);
+volatile uint64_t* _pagingCreateTable(volatile uint64_t* entry, uint64_t flags);
+
 g_physical_address pagingVirtualToPageEntry(g_virtual_address addr)
 {
 	auto pml4 = (g_address*) G_MEM_PHYS_TO_VIRT(pagingGetCurrentSpace());
@@ -46,7 +49,8 @@ g_physical_address pagingVirtualToPageEntry(g_virtual_address addr)
 		return 0;
 
 	if(pdValue & G_PAGE_LARGE_PAGE_FLAG)
-		return pdValue & ~G_PAGE_ALIGN_MASK;
+		return (pdValue & ~((uint64_t) G_PAGE_LARGE_ALIGN_MASK)) + (G_PAGE_ALIGN_DOWN(addr) & G_PAGE_LARGE_ALIGN_MASK) +
+		       (pdValue & G_PAGE_ALIGN_MASK & ~G_PAGE_LARGE_PAGE_FLAG);
 
 	auto pt = (g_address*) G_MEM_PHYS_TO_VIRT(ptAddr);
 	uint64_t ptIndex = G_PT_INDEX(addr);
@@ -78,57 +82,22 @@ bool pagingMapPage(g_virtual_address virt, g_physical_address phys,
 	if((virt & G_PAGE_ALIGN_MASK) || (phys & G_PAGE_ALIGN_MASK))
 		panic("%! tried to map unaligned addresses: %h -> %h", "paging", virt, phys);
 
-	auto pml4 = (volatile uint64_t*) G_MEM_PHYS_TO_VIRT(pagingGetCurrentSpace());
-
-
-	// Get PDPT from PML4
-	uint64_t pml4Index = G_PML4_INDEX(virt);
-	volatile uint64_t* pdpt;
-	if(!pml4[pml4Index])
-	{
-		g_physical_address newPdpt = bitmapPageAllocatorAllocate(&memoryPhysicalAllocator);
-		pml4[pml4Index] = newPdpt | pdptFlags;
-
-		pdpt = (volatile uint64_t*) G_MEM_PHYS_TO_VIRT(newPdpt);
-		for(int i = 0; i < 512; i++)
-			pdpt[i] = 0;
-	}
-	else
-	{
-		pdpt = (volatile uint64_t*) G_MEM_PHYS_TO_VIRT(pml4[pml4Index] & ~G_PAGE_ALIGN_MASK);
-	}
+	volatile uint64_t* pd = _pagingGetPageDirectory(virt, pdptFlags, pdFlags, true);
 
-	// Get PD from PDPT
-	uint64_t pdptIndex = G_PDPT_INDEX(virt);
-	volatile uint64_t* pd;
-	if(!pdpt[pdptIndex])
-	{
-		g_physical_address newPd = bitmapPageAllocatorAllocate(&memoryPhysicalAllocator);
-		pdpt[pdptIndex] = newPd | pdFlags;
-
-		pd = (volatile uint64_t*) G_MEM_PHYS_TO_VIRT(newPd);
-		for(int i = 0; i < 512; i++)
-			pd[i] = 0;
-	}
-	else
-	{
-		pd = (volatile uint64_t*) G_MEM_PHYS_TO_VIRT(pdpt[pdptIndex] & ~G_PAGE_ALIGN_MASK);
-	}
-
-	// Get PT from PD
+	// Get PT from PD, a large page is split so that the single page can be mapped
 	uint64_t pdIndex = G_PD_INDEX(virt);
 	volatile uint64_t* pt;
 	if(!pd[pdIndex])
 	{
-		g_physical_address newPt = bitmapPageAllocatorAllocate(&memoryPhysicalAllocator);
-		pd[pdIndex] = newPt | ptFlags;
-
-		pt = (volatile uint64_t*) G_MEM_PHYS_TO_VIRT(newPt);
-		for(int i = 0; i < 512; i++)
-			pt[i] = 0;
+		pt = _pagingCreateTable(&pd[pdIndex], ptFlags);
 	}
 	else
 	{
+		if(pd[pdIndex] & G_PAGE_LARGE_PAGE_FLAG)
+		{
+			pagingSplitLargePageEntry(&pd[pdIndex]);
+			pagingInvalidatePage(G_PAGE_LARGE_ALIGN_DOWN(virt));
+		}
 		pt = (volatile uint64_t*) G_MEM_PHYS_TO_VIRT(pd[pdIndex] & ~G_PAGE_ALIGN_MASK);
 	}
 
@@ -162,6 +131,12 @@ void pagingUnmapPage(g_virtual_address virt)
 	if(!pd[pdIndex])
 		return;
 
+	if(pd[pdIndex] & G_PAGE_LARGE_PAGE_FLAG)
+	{
+		pagingSplitLargePageEntry(&pd[pdIndex]);
+		pagingInvalidatePage(G_PAGE_LARGE_ALIGN_DOWN(virt));
+	}
+
 	auto pt = (volatile uint64_t*) G_MEM_PHYS_TO_VIRT(pd[pdIndex] & ~G_PAGE_ALIGN_MASK);
 	uint64_t ptIndex = G_PT_INDEX(virt);
 	if(!pt[ptIndex])
@@ -171,6 +146,113 @@ void pagingUnmapPage(g_virtual_address virt)
 	pagingInvalidatePage(virt);
 }
 
+bool pagingMapLargePage(g_virtual_address virt, g_physical_address phys, uint64_t tableFlags, uint64_t pageFlags,
+                        bool allowOverride)
+{
+	if((virt & G_PAGE_LARGE_ALIGN_MASK) || (phys & G_PAGE_LARGE_ALIGN_MASK))
+		panic("%! tried to map unaligned large page: %h -> %h", "paging", virt, phys);
+
+	volatile uint64_t* pd = _pagingGetPageDirectory(virt, tableFlags, tableFlags, true);
+	uint64_t pdIndex = G_PD_INDEX(virt);
+	uint64_t pdValue = pd[pdIndex];
+
+	if(pdValue && !(pdValue & G_PAGE_LARGE_PAGE_FLAG))
+	{
+		// An existing page table can only be replaced if nothing is mapped in it
+		auto pt = (volatile uint64_t*) G_MEM_PHYS_TO_VIRT(pdValue & ~G_PAGE_ALIGN_MASK);
+		for(int i = 0; i < 512; i++)
+		{
+			if(pt[i])
+			{
+				logInfo("%! failed to map large page at %x since its page table is in use", "paging", virt);
+				return false;
+			}
+		}
+		pd[pdIndex] = 0;
+		bitmapPageAllocatorMarkFree(&memoryPhysicalAllocator, pdValue & ~G_PAGE_ALIGN_MASK);
+	}
+	else if(pdValue && !allowOverride)
+	{
+		logInfo("%! failed to write large paging entry for %x since it is already set to: %x", "paging", virt, pdValue);
+		return false;
+	}
+
+	pd[pdIndex] = phys | pageFlags | G_PAGE_LARGE_PAGE_FLAG;
+	pagingInvalidatePage(virt);
+	return true;
+}
+
+bool pagingUnmapLargePage(g_virtual_address virt)
+{
+	volatile uint64_t* pd = _pagingGetPageDirectory(virt, 0, 0, false);
+	if(!pd)
+		return false;
+
+	uint64_t pdIndex = G_PD_INDEX(virt);
+	if(!(pd[pdIndex] & G_PAGE_LARGE_PAGE_FLAG))
+		return false;
+
+	pd[pdIndex] = 0;
+	pagingInvalidatePage(G_PAGE_LARGE_ALIGN_DOWN(virt));
+	return true;
+}
+
+void pagingSplitLargePageEntry(volatile uint64_t* entry)
+{
+	uint64_t value = *entry;
+	g_physical_address base = value & ~((uint64_t) G_PAGE_LARGE_ALIGN_MASK) & ~G_PAGE_NX_FLAG;
+	uint64_t flags = (value & (G_PAGE_ALIGN_MASK | G_PAGE_NX_FLAG)) & ~G_PAGE_LARGE_PAGE_FLAG;
+
+	g_physical_address ptPhys = bitmapPageAllocatorAllocate(&memoryPhysicalAllocator);
+	auto pt = (volatile uint64_t*) G_MEM_PHYS_TO_VIRT(ptPhys);
+	for(int i = 0; i < 512; i++)
+		pt[i] = (base + i * G_PAGE_SIZE) | flags;
+
+	*entry = ptPhys | (value & (G_PAGE_PRESENT | G_PAGE_WRITABLE_FLAG | G_PAGE_USER_FLAG));
+}
+
+/**
+ * Returns the page directory that covers the address in the current space.
+ *
+ * @param create
+ * 		whether missing tables are created with the given flags
+ * @return the page directory or null if it does not exist
+ */
+volatile uint64_t* _pagingGetPageDirectory(g_virtual_address virt, uint64_t pdptFlags, uint64_t pdFlags, bool create)
+{
+	auto pml4 = (volatile uint64_t*) G_MEM_PHYS_TO_VIRT(pagingGetCurrentSpace());
+
+	uint64_t pml4Index = G_PML4_INDEX(virt);
+	volatile uint64_t* pdpt;
+	if(pml4[pml4Index])
+		pdpt = (volatile uint64_t*) G_MEM_PHYS_TO_VIRT(pml4[pml4Index] & ~G_PAGE_ALIGN_MASK);
+	else if(create)
+		pdpt = _pagingCreateTable(&pml4[pml4Index], pdptFlags);
+	else
+		return nullptr;
+
+	uint64_t pdptIndex = G_PDPT_INDEX(virt);
+	if(pdpt[pdptIndex])
+		return (volatile uint64_t*) G_MEM_PHYS_TO_VIRT(pdpt[pdptIndex] & ~G_PAGE_ALIGN_MASK);
+	if(create)
+		return _pagingCreateTable(&pdpt[pdptIndex], pdFlags);
+	return nullptr;
+}
+
+/**
+ * Allocates a cleared paging structure and writes it to the entry.
+ */
+volatile uint64_t* _pagingCreateTable(volatile uint64_t* entry, uint64_t flags)
+{
+	g_physical_address tablePhys = bitmapPageAllocatorAllocate(&memoryPhysicalAllocator);
+	*entry = tablePhys | flags;
+
+	auto table = (volatile uint64_t*) G_MEM_PHYS_TO_VIRT(tablePhys);
+	for(int i = 0; i < 512; i++)
+		table[i] = 0;
+	return table;
+}
+
 g_physical_address pagingGetCurrentSpace()
 {
 	g_physical_address directory;
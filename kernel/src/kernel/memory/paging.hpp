@@ -33,8 +33,18 @@
 #define G_PAGE_DIRTY_FLAG       (1ULL << 6)  // Page has been written to (only for PT entries)
 #define G_PAGE_LARGE_PAGE_FLAG  (1ULL << 7)  // Page is a large page (2MB or 1GB)
 #define G_PAGE_GLOBAL_FLAG      (1ULL << 8)  // Page is global (only for PT entries)
+#define G_PAGE_COPY_ON_WRITE_FLAG (1ULL << 9) // Page is shared read-only and copied on the first write (ignored by the CPU)
+#define G_PAGE_SHARED_FLAG      (1ULL << 10) // Page stays shared when the process is forked (ignored by the CPU)
 #define G_PAGE_NX_FLAG          (1ULL << 63) // No-execute flag (if supported)
 
+/**
+ * Large pages are mapped directly in the page directory and cover 2 MiB.
+ */
+#define G_PAGE_LARGE_SIZE           0x200000
+#define G_PAGE_LARGE_ALIGN_MASK     (G_PAGE_LARGE_SIZE - 1)
+#define G_PAGE_LARGE_ALIGN_UP(v)    (((v) + G_PAGE_LARGE_ALIGN_MASK) & ~((g_address) G_PAGE_LARGE_ALIGN_MASK))
+#define G_PAGE_LARGE_ALIGN_DOWN(v)  ((v) & ~((g_address) G_PAGE_LARGE_ALIGN_MASK))
+
 /**
  * Default flag definitions
  */
@@ -62,7 +72,8 @@
 void pagingSwitchToSpace(g_physical_address dir);
 
 /**
- * Maps a page to the current address space.
+ * Maps a page to the current address space. If the page is part of a large page,
+ * the large page is split first.
  *
  * @param virt
  * 		the virtual address to map to
@@ -87,13 +98,47 @@ bool pagingMapPage(g_virtual_address virt, g_physical_address phys,
                    bool allowOverride = false);
 
 /**
- * Unmaps the given virtual page in the current address space.
+ * Unmaps the given virtual page in the current address space. If the page is part
+ * of a large page, the large page is split first.
  *
  * @param virt
  * 		the virtual address to unmap
  */
 void pagingUnmapPage(g_virtual_address virt);
 
+/**
+ * Maps a 2 MiB page to the current address space. An empty page table that
+ * exists at this place is freed.
+ *
+ * @param virt
+ * 		the virtual address to map to, aligned to G_PAGE_LARGE_SIZE
+ * @param phys
+ * 		the physical address, aligned to G_PAGE_LARGE_SIZE
+ * @param allowOverride
+ * 		whether an existing large page may be overriden
+ */
+bool pagingMapLargePage(g_virtual_address virt, g_physical_address phys,
+                        uint64_t tableFlags, uint64_t pageFlags,
+                        bool allowOverride = false);
+
+/**
+ * Unmaps the large page that covers the address in the current address space.
+ * Only the TLB of this processor is invalidated, if the space is used on other
+ * processors the caller must do a shootdown before the memory is reused.
+ *
+ * @return false if the address is not mapped by a large page
+ */
+bool pagingUnmapLargePage(g_virtual_address virt);
+
+/**
+ * Replaces a page directory entry that maps a large page with a page table that
+ * maps the same memory with the same flags in 4 KiB pages. The TLB entry for the
+ * large page must be invalidated by the caller if the space is active. Other
+ * processors may keep using the large page until a shootdown, so any page that
+ * is changed after splitting must be shot down by the caller.
+ */
+void pagingSplitLargePageEntry(volatile uint64_t* entry);
+
 /**
  * Returns the currently set page directory.
  *
@@ -109,6 +154,14 @@ static inline void pagingInvalidatePage(g_address addr)
     __asm__ __volatile__("invlpg (%0)" : : "r"(addr) : "memory");
 }
 
+/**
+ * Flushes all non-global entries from the TLB of the current processor.
+ */
+static inline void pagingFlushTlb()
+{
+    pagingSwitchToSpace(pagingGetCurrentSpace());
+}
+
 /**
  * Reads for a given virtual address (which must exist in the currently mapped
  * address space) the underlying physical address.
@@ -120,6 +173,12 @@ static inline void pagingInvalidatePage(g_address addr)
  */
 g_physical_address pagingVirtualToPhysical(g_virtual_address addr);
 
+/**
+ * Reads the page entry for a given virtual address. Within a large page, the entry
+ * is composed from the page directory entry and the address of the 4 KiB page. The
+ * G_PAGE_LARGE_PAGE_FLAG is removed, as the same bit selects the PAT in a 4 KiB
+ * page entry.
+ */
 g_physical_address pagingVirtualToPageEntry(g_virtual_address addr);
 
 #endif
@@ -26,4 +26,11 @@
  */
 #define G_TIMER_FREQUENCY 1000
 
+/**
+ * Longest time in milliseconds that a one-shot timer is armed for. When a
+ * processor has nothing to do but idle, it only wakes up this often unless
+ * a waiting task must be woken earlier or another processor requests it.
+ */
+#define G_TIMER_MAXIMUM_INTERVAL 100
+
 #endif
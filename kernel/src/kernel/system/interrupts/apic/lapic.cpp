@@ -32,6 +32,9 @@ static bool available = false;
 static g_physical_address physicalBase = 0;
 static g_virtual_address virtualBase = 0;
 
+// Timer ticks per millisecond as measured during calibration
+static uint32_t timerTicksPerMillisecond = 0;
+
 void lapicSetup(g_physical_address address)
 {
 	physicalBase = address;
@@ -132,11 +135,27 @@ void lapicStartTimer()
 
 	// Now we know how often the APIC timer has ticked in 10ms
 	uint32_t ticksPer10ms = 0xFFFFFFFF - lapicRead(APIC_REGISTER_TIMER_CURRCNT);
+	timerTicksPerMillisecond = ticksPer10ms / 10;
 
-	// Start timer as periodic on IRQ 0
+	// Start timer as one-shot on IRQ 0, from now on the clock re-arms it as needed
 	lapicWrite(APIC_REGISTER_TIMER_DIV, 0x3);
-	lapicWrite(APIC_REGISTER_LVT_TIMER, 0x20 | APIC_LVT_TIMER_MODE_PERIODIC);
-	lapicWrite(APIC_REGISTER_TIMER_INITCNT, ticksPer10ms / (G_TIMER_FREQUENCY / 100));
+	lapicTimerArm(ticksPer10ms / (G_TIMER_FREQUENCY / 100));
+}
+
+void lapicTimerArm(uint32_t ticks)
+{
+	lapicWrite(APIC_REGISTER_LVT_TIMER, 0x20 | APIC_LVT_TIMER_MODE_ONESHOT);
+	lapicWrite(APIC_REGISTER_TIMER_INITCNT, ticks ? ticks : 1);
+}
+
+uint32_t lapicTimerGetRemaining()
+{
+	return lapicRead(APIC_REGISTER_TIMER_CURRCNT);
+}
+
+uint32_t lapicTimerGetTicksPerMillisecond()
+{
+	return timerTicksPerMillisecond;
 }
 
 void lapicSendEndOfInterrupt()
@@ -146,7 +165,16 @@ void lapicSendEndOfInterrupt()
 
 void lapicWaitForIcrSend()
 {
-	while(APIC_LVT_GET_DELIVERY_STATUS(lapicRead(APIC_REGISTER_INT_COMMAND_HIGH)) == APIC_ICR_DELIVS_SEND_PENDING)
+	while(lapicRead(APIC_REGISTER_INT_COMMAND_LOW) & APIC_ICR_DELIVS_SEND_PENDING)
 	{
 	}
 }
+
+void lapicSendIpi(uint32_t apicId, uint8_t vector)
+{
+	// Interrupts must be disabled so that no other IPI is sent in between
+	lapicWaitForIcrSend();
+	lapicWrite(APIC_REGISTER_INT_COMMAND_HIGH, apicId << 24);
+	lapicWrite(APIC_REGISTER_INT_COMMAND_LOW, vector | APIC_ICR_DELMOD_FIXED | APIC_ICR_LEVEL_ASSERT |
+	                                          APIC_ICR_DEST_SHORTHAND_NONE);
+}
@@ -124,12 +124,20 @@ void lapicCreateMapping();
 
 void lapicStartTimer();
 
+void lapicTimerArm(uint32_t ticks);
+
+uint32_t lapicTimerGetRemaining();
+
+uint32_t lapicTimerGetTicksPerMillisecond();
+
 uint32_t lapicRead(uint32_t reg);
 
 void lapicWrite(uint32_t reg, uint32_t value);
 
 void lapicWaitForIcrSend();
 
+void lapicSendIpi(uint32_t apicId, uint8_t vector);
+
 void lapicSendEndOfInterrupt();
 
 #endif
@@ -97,6 +97,15 @@ bool exceptionsHandleDivideError(g_task* task)
 	return true;
 }
 
+bool exceptionsHandleDeviceNotAvailable(g_task* task)
+{
+	if(!task)
+		return false;
+
+	taskingActivateFpu(task);
+	return true;
+}
+
 g_elf_object* exceptionsFindResponsibleObject(g_task* task, g_address rip)
 {
 	g_elf_object* object = nullptr;
@@ -234,6 +243,10 @@ bool exceptionsHandlePageFault(g_task* task, volatile g_processor_state* state)
 
 	if(task)
 	{
+		// Write to a present page, must be checked before stack expansion
+		if((state->error & 3) == 3 && memoryCopyOnWriteHandlePageFault(task, accessed))
+			return true;
+
 		if(taskingMemoryHandleStackOverflow(task, accessed))
 			return true;
 
@@ -298,6 +311,12 @@ void exceptionsHandle(g_task* task, volatile g_processor_state* state)
 			resolved = exceptionsHandleDivideError(task);
 			break;
 		}
+		case 0x07:
+		{
+			// Device not available, FPU used while trapped
+			resolved = exceptionsHandleDeviceNotAvailable(task);
+			break;
+		}
 		case 0x0E:
 		{
 			// Page fault
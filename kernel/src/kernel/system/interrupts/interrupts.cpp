@@ -20,6 +20,7 @@
 
 #include "kernel/system/interrupts/interrupts.hpp"
 #include "kernel/memory/gdt.hpp"
+#include "kernel/memory/paging.hpp"
 #include "kernel/logger/logger.hpp"
 #include "kernel/calls/syscall.hpp"
 #include "kernel/system/interrupts/apic/ioapic.hpp"
@@ -32,9 +33,11 @@
 #include "kernel/system/timing/pit.hpp"
 #include "kernel/tasking/clock.hpp"
 #include "kernel/tasking/tasking.hpp"
+#include "kernel/system/system.hpp"
 #include "kernel/panic.hpp"
 
 void _interruptsSendEndOfInterrupt(uint8_t irq);
+void _interruptsHandleTlbFlushRequest();
 
 void interruptsInitializeBsp()
 {
@@ -81,18 +84,30 @@ extern "C" volatile g_processor_state* _interruptHandler(volatile g_processor_st
 	}
 	else if(state->intr == 0x81) // Yield
 	{
+		clockUpdate(false);
 		taskingSchedule();
 	}
 	else if(state->intr == 0x82) // Privilege downgrade for spawn
 	{
 		taskingFinalizeSpawn(task);
 	}
+	else if(state->intr == G_INTERRUPT_VECTOR_RESCHEDULE)
+	{
+		clockUpdate(false);
+		taskingSchedule();
+		lapicSendEndOfInterrupt();
+	}
+	else if(state->intr == G_INTERRUPT_VECTOR_TLB_FLUSH)
+	{
+		_interruptsHandleTlbFlushRequest();
+		lapicSendEndOfInterrupt();
+	}
 	else
 	{
 		uint8_t irq = state->intr - 0x20;
 		if(irq == 0) // Timer
 		{
-			clockUpdate();
+			clockUpdate(true);
 			taskingSchedule(true);
 		}
 		else
@@ -108,6 +123,9 @@ extern "C" volatile g_processor_state* _interruptHandler(volatile g_processor_st
 	if(newTask != task)
 		taskingRestoreState(newTask);
 
+	// Handling the interrupt is accounted as kernel time of the interrupted task
+	taskingAccountTime(task, false);
+
 	return newTask->state;
 }
 
@@ -127,6 +145,70 @@ bool interruptsAreEnabled()
 	return eflags & (1 << 9);
 }
 
+void interruptsSendReschedule(uint32_t processor)
+{
+	if(!lapicIsAvailable() || !systemIsReady() || processor == processorGetCurrentId())
+		return;
+
+	lapicSendIpi(processorGetApicId(processor), G_INTERRUPT_VECTOR_RESCHEDULE);
+}
+
+void interruptsSendTlbFlush()
+{
+	interruptsSendTlbFlush(0);
+}
+
+void interruptsSendTlbFlush(g_physical_address space)
+{
+	uint16_t processors = processorGetNumberOfProcessors();
+	if(!lapicIsAvailable() || !systemIsReady() || processors < 2)
+	{
+		pagingFlushTlb();
+		return;
+	}
+
+	INTERRUPTS_PAUSE;
+	uint32_t current = processorGetCurrentId();
+
+	// Entries were changed before, make them visible before checking which spaces are active
+	__sync_synchronize();
+	for(uint32_t i = 0; i < processors; i++)
+	{
+		g_tasking_local* local = taskingGetLocalOf(i);
+		if(i == current || (space && local->activeSpace != space))
+			continue;
+
+		local->tlbFlushRequested = true;
+		lapicSendIpi(processorGetApicId(i), G_INTERRUPT_VECTOR_TLB_FLUSH);
+	}
+
+	pagingFlushTlb();
+
+	// Requests to this processor are handled while waiting, so that two shootdowns can't block each other
+	for(uint32_t i = 0; i < processors; i++)
+	{
+		while(taskingGetLocalOf(i)->tlbFlushRequested)
+		{
+			_interruptsHandleTlbFlushRequest();
+			asm volatile("pause");
+		}
+	}
+	INTERRUPTS_RESUME;
+}
+
+/**
+ * Flushes the TLB of this processor if another processor has requested it.
+ */
+void _interruptsHandleTlbFlushRequest()
+{
+	g_tasking_local* local = taskingGetLocal();
+	if(local->tlbFlushRequested)
+	{
+		pagingFlushTlb();
+		local->tlbFlushRequested = false;
+	}
+}
+
 void _interruptsSendEndOfInterrupt(uint8_t irq)
 {
 	if(lapicIsAvailable())
@@ -268,8 +350,8 @@ void interruptsInstallRoutines()
 	idtCreateGate(0x80, (void*) _isr80, G_IDT_FLAGS_INTERRUPT_GATE_USER); // syscall
 	idtCreateGate(0x81, (void*) _isr81, G_IDT_FLAGS_INTERRUPT_GATE_KERNEL); // yield
 	idtCreateGate(0x82, (void*) _isr82, G_IDT_FLAGS_INTERRUPT_GATE_KERNEL); // privilege downgrade
-	idtCreateGate(0x83, (void*) _isr83, G_IDT_FLAGS_INTERRUPT_GATE_KERNEL);
-	idtCreateGate(0x84, (void*) _isr84, G_IDT_FLAGS_INTERRUPT_GATE_KERNEL);
+	idtCreateGate(0x83, (void*) _isr83, G_IDT_FLAGS_INTERRUPT_GATE_KERNEL); // reschedule
+	idtCreateGate(0x84, (void*) _isr84, G_IDT_FLAGS_INTERRUPT_GATE_KERNEL); // tlb flush
 	idtCreateGate(0x85, (void*) _isr85, G_IDT_FLAGS_INTERRUPT_GATE_KERNEL);
 	idtCreateGate(0x86, (void*) _isr86, G_IDT_FLAGS_INTERRUPT_GATE_KERNEL);
 	idtCreateGate(0x87, (void*) _isr87, G_IDT_FLAGS_INTERRUPT_GATE_KERNEL);
@@ -22,6 +22,17 @@
 #define __KERNEL_INTERRUPTS__
 
 #include "kernel/system/processor/processor_state.hpp"
+#include <ghost/memory/types.h>
+
+/**
+ * Vector of the inter-processor interrupt that makes a processor schedule.
+ */
+#define G_INTERRUPT_VECTOR_RESCHEDULE 0x83
+
+/**
+ * Vector of the inter-processor interrupt that makes a processor flush its TLB.
+ */
+#define G_INTERRUPT_VECTOR_TLB_FLUSH 0x84
 
 /**
  * Pauses/resumes interrupts within the same scope.
@@ -59,6 +70,27 @@ void interruptsDisable();
  */
 bool interruptsAreEnabled();
 
+/**
+ * Sends an inter-processor interrupt to the given processor so that it schedules.
+ * Must be called with interrupts disabled.
+ */
+void interruptsSendReschedule(uint32_t processor);
+
+/**
+ * Flushes the TLB on all processors and waits until every other processor has
+ * done so. Must be called without holding any lock, otherwise the other processors
+ * might never get to handle the interrupt. While waiting, requests of other
+ * processors are handled, so this may also be called with interrupts disabled.
+ */
+void interruptsSendTlbFlush();
+
+/**
+ * Like interruptsSendTlbFlush, but only reaches the processors that currently
+ * have the given address space loaded. Processors that switch to it later load
+ * it fresh anyway.
+ */
+void interruptsSendTlbFlush(g_physical_address space);
+
 /**
  * Installs all ISRs into the IDT.
  */
@@ -65,5 +65,5 @@ void requestsHandle(g_task* currentTask, uint8_t irq)
 
 	// Once the handler has finished, let the scheduler go back to interrupted task
 	if(currentTask)
-		schedulerPrefer(currentTask->id);
+		schedulerPrefer(currentTask);
 }
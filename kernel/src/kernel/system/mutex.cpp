@@ -23,17 +23,31 @@
 #include "kernel/system/processor/processor.hpp"
 #include "kernel/system/system.hpp"
 #include "kernel/tasking/tasking.hpp"
+#include "kernel/utils/string.hpp"
 #include "kernel/logger/logger.hpp"
 #include "kernel/panic.hpp"
 
 #define G_MUTEX_INITIALIZED 0xFEED
 #define G_MUTEX_MAX_PAUSES 1024
+#define G_MUTEX_TICKET_PAUSES 16
 #define G_MUTEX_NO_OWNER (-1)
+#define G_MUTEX_STATISTICS_LOCATIONS 128
 
 g_spinlock mutexInitializerLock = 0;
 
+#if G_DEBUG_LOCK_STATISTICS
+static g_mutex_statistics mutexStatistics[G_MUTEX_STATISTICS_LOCATIONS];
+static uint32_t mutexStatisticsUsed = 0;
+#endif
+
 bool _mutexTryAcquire(g_mutex* mutex, uint32_t owner, bool hadIF);
+void _mutexAcquireGlobal(g_mutex* mutex, uint32_t owner, bool hadIF);
+void _mutexTakeOwnership(g_mutex* mutex, uint32_t owner, bool hadIF);
+bool _mutexSleep(g_mutex* mutex, g_task* task, uint32_t owner, bool hadIF);
+g_task* _mutexHandOver(g_mutex* mutex);
 void _mutexInitialize(g_mutex* mutex, g_mutex_type type, const char* location);
+void _mutexStatisticsAcquired(g_mutex* mutex, uint64_t start, uint32_t spins);
+void _mutexStatisticsReleased(g_mutex* mutex);
 
 void mutexErrorUninitialized(g_mutex* mutex)
 {
@@ -56,11 +70,38 @@ void _mutexInitialize(g_mutex* mutex, g_mutex_type type, const char* location)
 
 	mutex->initialized = G_MUTEX_INITIALIZED;
 	mutex->lock = 0;
+	mutex->ticket.next = 0;
+	mutex->ticket.serving = 0;
 	mutex->depth = 0;
 	mutex->owner = -1;
+	mutex->waitersHead = nullptr;
+	mutex->waitersTail = nullptr;
 	mutex->type = type;
 	mutex->location = location;
 
+#if G_DEBUG_LOCK_STATISTICS
+	// Mutexes from the same location share their statistics
+	mutex->statistics = nullptr;
+	mutex->acquiredTime = 0;
+	for(uint32_t i = 0; i < mutexStatisticsUsed; i++)
+	{
+		g_mutex_statistics* statistics = &mutexStatistics[i];
+		if(statistics->type == type &&
+		   (statistics->location == location || stringEquals(statistics->location, location)))
+		{
+			mutex->statistics = statistics;
+			break;
+		}
+	}
+	if(!mutex->statistics && mutexStatisticsUsed < G_MUTEX_STATISTICS_LOCATIONS)
+	{
+		g_mutex_statistics* statistics = &mutexStatistics[mutexStatisticsUsed++];
+		statistics->location = location;
+		statistics->type = type;
+		mutex->statistics = statistics;
+	}
+#endif
+
 	G_SPINLOCK_RELEASE(mutexInitializerLock);
 }
 
@@ -88,12 +129,24 @@ void mutexAcquire(g_mutex* mutex)
 	bool hadIF = interruptsAreEnabled();
 	interruptsDisable();
 
+	if(mutex->type == G_MUTEX_TYPE_GLOBAL)
+	{
+		_mutexAcquireGlobal(mutex, owner, hadIF);
+		return;
+	}
+
+	g_task* task = systemIsReady() ? taskingGetCurrentTask() : nullptr;
+	uint64_t start = G_DEBUG_LOCK_STATISTICS ? processorReadTsc() : 0;
+
 	int deadlock = 0;
 	uint32_t pauses = 1;
+	uint32_t spins = 0;
 	while(!_mutexTryAcquire(mutex, owner, hadIF))
 	{
+		++spins;
+
 		// As long as any global mutex is locked, we may never yield
-		if(mutex->type == G_MUTEX_TYPE_GLOBAL || taskingGetLocal()->locking.globalLockCount > 0)
+		if(taskingGetLocal()->locking.globalLockCount > 0)
 		{
 			for(uint32_t i = 0; i < pauses; i++)
 				asm volatile("pause");
@@ -101,8 +154,19 @@ void mutexAcquire(g_mutex* mutex)
 			if(pauses > G_MUTEX_MAX_PAUSES)
 				pauses = G_MUTEX_MAX_PAUSES;
 		}
+		else if(task && task->status == G_TASK_STATUS_RUNNING)
+		{
+			// Sleep until the mutex is handed over to this task
+			while(!_mutexSleep(mutex, task, owner, hadIF))
+			{
+				taskingYield();
+				++spins;
+			}
+			break;
+		}
 		else
 		{
+			// Task is about to wait for something else, must not be woken by the mutex
 			taskingYield();
 		}
 
@@ -113,11 +177,45 @@ void mutexAcquire(g_mutex* mutex)
 					 mutex->location, mutex->owner);
 	}
 
+	if(mutex->depth == 1)
+		_mutexStatisticsAcquired(mutex, start, spins);
+
 	// Only for task mutexes (and if previously enabled) interrupts are enabled again
-	if(mutex->type == G_MUTEX_TYPE_TASK && hadIF)
+	if(hadIF)
 		interruptsEnable();
 }
 
+void _mutexAcquireGlobal(g_mutex* mutex, uint32_t owner, bool hadIF)
+{
+	// Only this processor can have set itself as the owner, so this is safe without lock
+	if(mutex->depth > 0 && mutex->owner == owner)
+	{
+		++mutex->depth;
+		return;
+	}
+
+	uint64_t start = G_DEBUG_LOCK_STATISTICS ? processorReadTsc() : 0;
+	uint32_t ticket = G_TICKET_SPINLOCK_DRAW(mutex->ticket);
+
+	int deadlock = 0;
+	uint32_t ahead;
+	while((ahead = G_TICKET_SPINLOCK_AHEAD(mutex->ticket, ticket)) != 0)
+	{
+		// Back off in proportion to the number of processors that are served first
+		for(uint32_t i = 0; i < ahead * G_MUTEX_TICKET_PAUSES; i++)
+			asm volatile("pause");
+
+		// Check for deadlocks
+		++deadlock;
+		if(deadlock % 100000 == 0)
+			logDebug("%! long lock on processor %i initialized at %s, owner is: %i", "mutex", processorGetCurrentId(),
+					 mutex->location, mutex->owner);
+	}
+
+	_mutexTakeOwnership(mutex, owner, hadIF);
+	_mutexStatisticsAcquired(mutex, start, deadlock);
+}
+
 bool _mutexTryAcquire(g_mutex* mutex, uint32_t owner, bool hadIF)
 {
 	bool wasSet = false;
@@ -126,27 +224,154 @@ bool _mutexTryAcquire(g_mutex* mutex, uint32_t owner, bool hadIF)
 
 	if(mutex->depth == 0 || mutex->owner == owner)
 	{
-		// On the first acquire of each global mutex, increase global lock count
-		if(mutex->depth == 0 && mutex->type == G_MUTEX_TYPE_GLOBAL && systemIsReady())
+		_mutexTakeOwnership(mutex, owner, hadIF);
+		wasSet = true;
+	}
+
+	G_SPINLOCK_RELEASE(mutex->lock);
+
+	return wasSet;
+}
+
+/**
+ * Either acquires the task mutex or queues the task as a waiter and marks it as
+ * waiting; the caller must then yield. Also returns true once the mutex was handed
+ * over to the task.
+ */
+bool _mutexSleep(g_mutex* mutex, g_task* task, uint32_t owner, bool hadIF)
+{
+	bool acquired = false;
+
+	G_SPINLOCK_ACQUIRE(mutex->lock);
+
+	if(task->mutexWait.granted)
+	{
+		task->mutexWait.granted = false;
+		task->mutexWait.mutex = nullptr;
+		acquired = true;
+	}
+	else if(task->mutexWait.mutex != mutex && (mutex->depth == 0 || mutex->owner == owner))
+	{
+		_mutexTakeOwnership(mutex, owner, hadIF);
+		acquired = true;
+	}
+	else
+	{
+		if(task->mutexWait.mutex != mutex)
 		{
-			auto local = taskingGetLocal();
+			task->mutexWait.mutex = mutex;
+			task->mutexWait.next = nullptr;
+			if(mutex->waitersTail)
+				mutex->waitersTail->mutexWait.next = task;
+			else
+				mutex->waitersHead = task;
+			mutex->waitersTail = task;
+		}
+
+		mutexAcquire(&task->lock);
+		task->status = G_TASK_STATUS_WAITING;
+		task->waitsFor = mutex->location;
+		mutexRelease(&task->lock);
+	}
 
-			// Only store IF state if no other global mutex is locked yet
-			if(local->locking.globalLockCount == 0)
-				local->locking.globalLockSetIFAfterRelease = hadIF;
+	G_SPINLOCK_RELEASE(mutex->lock);
 
-			local->locking.globalLockCount++;
+	return acquired;
+}
+
+/**
+ * Passes a task mutex that is no longer held to the first living waiter, or frees it
+ * if there is none. The mutex lock must be held.
+ *
+ * @return the task that must be woken
+ */
+g_task* _mutexHandOver(g_mutex* mutex)
+{
+	while(g_task* waiter = mutex->waitersHead)
+	{
+		mutex->waitersHead = waiter->mutexWait.next;
+		if(!mutex->waitersHead)
+			mutex->waitersTail = nullptr;
+		waiter->mutexWait.next = nullptr;
+
+		if(waiter->status == G_TASK_STATUS_DEAD)
+		{
+			waiter->mutexWait.mutex = nullptr;
+			continue;
 		}
 
-		// Increase reentrancy depth and update owner
-		++mutex->depth;
-		mutex->owner = owner;
-		wasSet = true;
+		waiter->mutexWait.granted = true;
+		mutex->depth = 1;
+		mutex->owner = waiter->id;
+		return waiter;
+	}
+
+	mutex->owner = -1;
+	return nullptr;
+}
+
+void mutexDetachWaiter(g_task* task)
+{
+	g_mutex* mutex = task->mutexWait.mutex;
+	if(!mutex)
+		return;
+
+	INTERRUPTS_PAUSE;
+	G_SPINLOCK_ACQUIRE(mutex->lock);
+
+	g_task* wake = nullptr;
+	if(task->mutexWait.granted)
+	{
+		// Handed over to a task that died before it could run, pass it on
+		task->mutexWait.granted = false;
+		mutex->depth = 0;
+		wake = _mutexHandOver(mutex);
 	}
+	else
+	{
+		g_task* previous = nullptr;
+		for(g_task* waiter = mutex->waitersHead; waiter; waiter = waiter->mutexWait.next)
+		{
+			if(waiter == task)
+			{
+				if(previous)
+					previous->mutexWait.next = task->mutexWait.next;
+				else
+					mutex->waitersHead = task->mutexWait.next;
+				if(mutex->waitersTail == task)
+					mutex->waitersTail = previous;
+				break;
+			}
+			previous = waiter;
+		}
+	}
+	task->mutexWait.mutex = nullptr;
+	task->mutexWait.next = nullptr;
 
 	G_SPINLOCK_RELEASE(mutex->lock);
 
-	return wasSet;
+	if(wake)
+		taskingWake(wake);
+	INTERRUPTS_RESUME;
+}
+
+void _mutexTakeOwnership(g_mutex* mutex, uint32_t owner, bool hadIF)
+{
+	// On the first acquire of each global mutex, increase global lock count
+	if(mutex->depth == 0 && mutex->type == G_MUTEX_TYPE_GLOBAL && systemIsReady())
+	{
+		auto local = taskingGetLocal();
+
+		// Only store IF state if no other global mutex is locked yet
+		if(local->locking.globalLockCount == 0)
+			local->locking.globalLockSetIFAfterRelease = hadIF;
+
+		local->locking.globalLockCount++;
+	}
+
+	// Increase reentrancy depth and update owner
+	++mutex->depth;
+	mutex->owner = owner;
 }
 
 void mutexRelease(g_mutex* mutex)
@@ -156,9 +381,13 @@ void mutexRelease(g_mutex* mutex)
 
 	// No interruption allowed during check
 	bool setIF = false;
+	g_task* wake = nullptr;
 	interruptsDisable();
 
-	G_SPINLOCK_ACQUIRE(mutex->lock);
+	// Global mutexes are only ever released by their owner, which needs no lock
+	bool global = mutex->type == G_MUTEX_TYPE_GLOBAL;
+	if(!global)
+		G_SPINLOCK_ACQUIRE(mutex->lock);
 
 	if(mutex->depth > 0)
 	{
@@ -177,14 +406,99 @@ void mutexRelease(g_mutex* mutex)
 					setIF = local->locking.globalLockSetIFAfterRelease;
 			}
 
-			// Remove owner
-			mutex->owner = -1;
+			_mutexStatisticsReleased(mutex);
+
+			if(global)
+			{
+				// Remove owner
+				mutex->owner = -1;
+				G_TICKET_SPINLOCK_RELEASE(mutex->ticket);
+			}
+			else
+			{
+				wake = _mutexHandOver(mutex);
+			}
 		}
 	}
 
-	G_SPINLOCK_RELEASE(mutex->lock);
+	if(!global)
+		G_SPINLOCK_RELEASE(mutex->lock);
+
+	if(wake)
+		taskingWake(wake);
 
 	// Restore IF state according to rules above
 	if(setIF)
 		interruptsEnable();
 }
+
+#if G_DEBUG_LOCK_STATISTICS
+/**
+ * Raises a maximum value that is shared between processors.
+ */
+static void _mutexStatisticsRaise(uint64_t* maximum, uint64_t value)
+{
+	uint64_t current;
+	while(value > (current = *((volatile uint64_t*) maximum)))
+	{
+		if(__sync_bool_compare_and_swap(maximum, current, value))
+			break;
+	}
+}
+#endif
+
+void _mutexStatisticsAcquired(g_mutex* mutex, uint64_t start, uint32_t spins)
+{
+#if G_DEBUG_LOCK_STATISTICS
+	uint64_t now = processorReadTsc();
+	mutex->acquiredTime = now;
+
+	g_mutex_statistics* statistics = mutex->statistics;
+	if(!statistics)
+		return;
+
+	__sync_fetch_and_add(&statistics->acquisitions, 1);
+	if(spins > 0)
+	{
+		__sync_fetch_and_add(&statistics->contended, 1);
+		__sync_fetch_and_add(&statistics->spins, spins);
+		__sync_fetch_and_add(&statistics->waitTime, now - start);
+		_mutexStatisticsRaise(&statistics->waitMax, now - start);
+	}
+#endif
+}
+
+void _mutexStatisticsReleased(g_mutex* mutex)
+{
+#if G_DEBUG_LOCK_STATISTICS
+	g_mutex_statistics* statistics = mutex->statistics;
+	if(!statistics)
+		return;
+
+	uint64_t held = processorReadTsc() - mutex->acquiredTime;
+	__sync_fetch_and_add(&statistics->holdTime, held);
+	_mutexStatisticsRaise(&statistics->holdMax, held);
+#endif
+}
+
+uint32_t mutexStatisticsCount()
+{
+#if G_DEBUG_LOCK_STATISTICS
+	return mutexStatisticsUsed;
+#else
+	return 0;
+#endif
+}
+
+bool mutexStatisticsGet(uint32_t index, g_mutex_statistics* out)
+{
+#if G_DEBUG_LOCK_STATISTICS
+	if(index >= mutexStatisticsUsed)
+		return false;
+
+	*out = mutexStatistics[index];
+	return true;
+#else
+	return false;
+#endif
+}
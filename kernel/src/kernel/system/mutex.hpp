@@ -21,33 +21,69 @@
 #ifndef __SYSTEM_MUTEX__
 #define __SYSTEM_MUTEX__
 
+#include "kernel/build_config.hpp"
 #include "kernel/system/spinlock.hpp"
 
 #include <ghost/stdint.h>
 
+struct g_task;
+
 typedef int g_mutex_type;
 #define G_MUTEX_TYPE_GLOBAL   ((g_mutex_type) 0)
 #define G_MUTEX_TYPE_TASK     ((g_mutex_type) 1)
 
+/**
+ * Contention statistics of all mutexes that were initialized at the same location.
+ * Times are in timestamp counter ticks.
+ */
+struct g_mutex_statistics
+{
+    const char* location;
+    g_mutex_type type;
+
+    uint64_t acquisitions;
+    uint64_t contended;
+    uint64_t spins;
+
+    uint64_t waitTime;
+    uint64_t waitMax;
+    uint64_t holdTime;
+    uint64_t holdMax;
+};
+
 typedef struct
 {
     volatile int initialized;
     g_spinlock lock;
+    g_ticket_spinlock ticket;
 
     const char* location;
     g_mutex_type type;
     int depth;
     uint32_t owner;
+
+    /**
+     * Tasks sleeping on a task mutex, in order of arrival.
+     */
+    g_task* waitersHead;
+    g_task* waitersTail;
+
+#if G_DEBUG_LOCK_STATISTICS
+    g_mutex_statistics* statistics;
+    uint64_t acquiredTime;
+#endif
 } __attribute__((packed)) g_mutex;
 
 /**
- * Initializes a task mutex. This mutex will yield until it can be acquired.
+ * Initializes a task mutex. A task that finds this mutex held sleeps until it
+ * is released, the mutex is then handed over to the first waiter directly.
  */
 void mutexInitializeTask(g_mutex* mutex, const char* location = "unknown");
 
 /**
  * Initializes a global mutex for a critical section. Acquiring any global
- * mutex disables interrupts until the last one is released.
+ * mutex disables interrupts until the last one is released. Processors waiting
+ * for a global mutex are served in the order they arrived.
  */
 void mutexInitializeGlobal(g_mutex* mutex, const char* location = "unknown");
 
@@ -61,4 +97,21 @@ void mutexAcquire(g_mutex* mutex);
  */
 void mutexRelease(g_mutex* mutex);
 
+/**
+ * Removes a task from the waiters of the task mutex it sleeps on, if any.
+ */
+void mutexDetachWaiter(g_task* task);
+
+/**
+ * @return the number of distinct mutex locations with statistics
+ */
+uint32_t mutexStatisticsCount();
+
+/**
+ * Copies the statistics of the mutex location with the given index.
+ *
+ * @return whether the index was valid
+ */
+bool mutexStatisticsGet(uint32_t index, g_mutex_statistics* out);
+
 #endif
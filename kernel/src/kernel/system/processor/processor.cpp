@@ -29,6 +29,7 @@
 static g_processor* processors = nullptr;
 static uint32_t processorsAvailable = 0;
 static uint32_t* apicIdToProcessorMapping = nullptr;
+static uint32_t* processorToApicIdMapping = nullptr;
 
 /**
  * @return the current processor structure; only available after all cores have
@@ -55,6 +56,8 @@ void processorInitializeBsp()
 
 void processorFinalizeSetup()
 {
+	processorEnableWriteProtect();
+
 	if(processorHasFeature(g_cpuid_standard_edx_feature::SSE))
 	{
 		_enableSSE();
@@ -104,13 +107,23 @@ void processorApicIdCreateMappingTable()
 	uint32_t mappingSize = sizeof(uint32_t) * (highestApicId + 1);
 	uint32_t* mapping = (uint32_t*) heapAllocate(mappingSize);
 	memorySetBytes((void*) mapping, 0, mappingSize);
+	uint32_t* reverseMapping = (uint32_t*) heapAllocate(sizeof(uint32_t) * processorsAvailable);
 	p = processors;
 	while(p)
 	{
 		mapping[p->apicId] = p->id;
+		reverseMapping[p->id] = p->apicId;
 		p = p->next;
 	}
 	apicIdToProcessorMapping = mapping;
+	processorToApicIdMapping = reverseMapping;
+}
+
+uint32_t processorGetApicId(uint32_t processorId)
+{
+	if(!processorToApicIdMapping || processorId >= processorsAvailable)
+		return 0;
+	return processorToApicIdMapping[processorId];
 }
 
 void processorAdd(uint32_t apicId, uint32_t processorHardwareId)
@@ -301,6 +314,31 @@ void processorRestoreFpuState(uint8_t* source)
 	);
 }
 
+void processorEnableFpuTrap()
+{
+	uint64_t cr0;
+	asm volatile("mov %%cr0, %0"
+		: "=r"(cr0));
+	asm volatile("mov %0, %%cr0"
+		:
+		: "r"(cr0 | G_CR0_TS));
+}
+
+void processorDisableFpuTrap()
+{
+	asm volatile("clts");
+}
+
+void processorEnableWriteProtect()
+{
+	uint64_t cr0;
+	asm volatile("mov %%cr0, %0"
+		: "=r"(cr0));
+	asm volatile("mov %0, %%cr0"
+		:
+		: "r"(cr0 | G_CR0_WP));
+}
+
 const uint8_t* processorGetInitialFpuState()
 {
 	return _processorGetCurrent()->fpu.initialState;
@@ -102,6 +102,17 @@ enum class g_cpuid_extended_ecx_feature
 #define IA32_APIC_BASE_MSR_BSP		0x100
 #define IA32_APIC_BASE_MSR_ENABLE	0x800
 
+/**
+ * CR0 task-switched flag, causes a device-not-available exception on the
+ * next FPU/SSE instruction while set
+ */
+#define G_CR0_TS					(1 << 3)
+
+/**
+ * CR0 write-protect flag, makes read-only pages also read-only for the kernel
+ */
+#define G_CR0_WP					(1 << 16)
+
 struct g_processor
 {
     uint32_t id;
@@ -183,6 +194,11 @@ uint32_t processorGetCurrentIdFromApic();
  */
 void processorApicIdCreateMappingTable();
 
+/**
+ * Returns the id of the local APIC of the processor with the given logical id.
+ */
+uint32_t processorGetApicId(uint32_t processorId);
+
 /**
  * Checks if the processor supports the given standard EDX feature.
  */
@@ -233,6 +249,23 @@ void processorSaveFpuState(uint8_t* target);
  */
 void processorRestoreFpuState(uint8_t* source);
 
+/**
+ * Sets the task-switched flag so that the next FPU/SSE instruction on this
+ * processor causes a device-not-available exception.
+ */
+void processorEnableFpuTrap();
+
+/**
+ * Clears the task-switched flag, allowing FPU/SSE instructions again.
+ */
+void processorDisableFpuTrap();
+
+/**
+ * Sets the write-protect flag so that supervisor writes to read-only pages fault,
+ * which is required for copy-on-write pages to be resolved when the kernel writes.
+ */
+void processorEnableWriteProtect();
+
 /**
  * Checks if a processor feature is available and initialized.
  *
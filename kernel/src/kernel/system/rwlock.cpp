@@ -0,0 +1,116 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                                                                           *
+ *  Ghost, a micro-kernel based operating system for the x86 architecture    *
+ *  Copyright (C) 2015, Max Schlüssel <lokoxe@gmail.com>                     *
+ *                                                                           *
+ *  This program is free software: you can redistribute it and/or modify     *
+ *  it under the terms of the GNU General Public License as published by     *
+ *  the Free Software Foundation, either version 3 of the License, or        *
+ *  (at your option) any later version.                                      *
+ *                                                                           *
+ *  This program is distributed in the hope that it will be useful,          *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of           *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the            *
+ *  GNU General Public License for more details.                             *
+ *                                                                           *
+ *  You should have received a copy of the GNU General Public License        *
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.    *
+ *                                                                           *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "kernel/system/rwlock.hpp"
+#include "kernel/system/interrupts/interrupts.hpp"
+#include "kernel/system/processor/processor.hpp"
+#include "kernel/system/system.hpp"
+#include "kernel/tasking/tasking.hpp"
+
+bool _rwlockIsWriter(g_rwlock* lock);
+bool _rwlockHasWriter(g_rwlock* lock);
+
+void rwlockInitialize(g_rwlock* lock, const char* location)
+{
+	mutexInitializeGlobal(&lock->writer, location);
+	lock->readers = 0;
+	lock->writersWaiting = 0;
+}
+
+void rwlockAcquireRead(g_rwlock* lock)
+{
+	bool hadIF = interruptsAreEnabled();
+	interruptsDisable();
+
+	// Count as a held global lock, so that interrupts stay disabled until released
+	if(systemIsReady())
+	{
+		auto local = taskingGetLocal();
+		if(local->locking.globalLockCount == 0)
+			local->locking.globalLockSetIFAfterRelease = hadIF;
+		local->locking.globalLockCount++;
+	}
+
+	// Within the own write section nothing has to be waited for
+	if(_rwlockIsWriter(lock))
+		return;
+
+	for(;;)
+	{
+		__sync_fetch_and_add(&lock->readers, 1);
+		if(!_rwlockHasWriter(lock))
+			break;
+
+		// Writer is active or waiting, back off until it is done
+		__sync_fetch_and_sub(&lock->readers, 1);
+		while(_rwlockHasWriter(lock))
+			asm volatile("pause");
+	}
+}
+
+void rwlockReleaseRead(g_rwlock* lock)
+{
+	if(!_rwlockIsWriter(lock))
+		__sync_fetch_and_sub(&lock->readers, 1);
+
+	bool setIF = false;
+	if(systemIsReady())
+	{
+		auto local = taskingGetLocal();
+		local->locking.globalLockCount--;
+		if(local->locking.globalLockCount == 0)
+			setIF = local->locking.globalLockSetIFAfterRelease;
+	}
+
+	if(setIF)
+		interruptsEnable();
+}
+
+void rwlockAcquireWrite(g_rwlock* lock)
+{
+	// Announce the writer before waiting for the ticket, so that new readers hold back
+	__sync_fetch_and_add(&lock->writersWaiting, 1);
+	mutexAcquire(&lock->writer);
+	__sync_fetch_and_sub(&lock->writersWaiting, 1);
+
+	while(lock->readers > 0)
+		asm volatile("pause");
+}
+
+void rwlockReleaseWrite(g_rwlock* lock)
+{
+	mutexRelease(&lock->writer);
+}
+
+/**
+ * Whether the current processor holds the lock for writing.
+ */
+bool _rwlockIsWriter(g_rwlock* lock)
+{
+	return *((volatile int*) &lock->writer.depth) > 0 && lock->writer.owner == processorGetCurrentId();
+}
+
+/**
+ * Whether a writer holds the lock or waits for it.
+ */
+bool _rwlockHasWriter(g_rwlock* lock)
+{
+	return *((volatile int*) &lock->writer.depth) != 0 || lock->writersWaiting != 0;
+}
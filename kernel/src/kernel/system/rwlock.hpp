@@ -0,0 +1,66 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                                                                           *
+ *  Ghost, a micro-kernel based operating system for the x86 architecture    *
+ *  Copyright (C) 2015, Max Schlüssel <lokoxe@gmail.com>                     *
+ *                                                                           *
+ *  This program is free software: you can redistribute it and/or modify     *
+ *  it under the terms of the GNU General Public License as published by     *
+ *  the Free Software Foundation, either version 3 of the License, or        *
+ *  (at your option) any later version.                                      *
+ *                                                                           *
+ *  This program is distributed in the hope that it will be useful,          *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of           *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the            *
+ *  GNU General Public License for more details.                             *
+ *                                                                           *
+ *  You should have received a copy of the GNU General Public License        *
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.    *
+ *                                                                           *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef __SYSTEM_RWLOCK__
+#define __SYSTEM_RWLOCK__
+
+#include "kernel/system/mutex.hpp"
+
+/**
+ * Lock for read-mostly data. Any number of processors may hold it for reading at
+ * the same time, writers are exclusive and keep new readers out while they wait.
+ *
+ * Like a global mutex, holding the lock in either mode disables interrupts. The
+ * writer may acquire the lock again (also for reading). A reader may neither upgrade
+ * nor acquire the lock for reading again, since a waiting writer blocks it.
+ */
+typedef struct
+{
+    g_mutex writer;
+    volatile int readers;
+    volatile int writersWaiting;
+} __attribute__((packed)) g_rwlock;
+
+/**
+ * Initializes the lock.
+ */
+void rwlockInitialize(g_rwlock* lock, const char* location = "unknown");
+
+/**
+ * Acquires the lock for reading.
+ */
+void rwlockAcquireRead(g_rwlock* lock);
+
+/**
+ * Releases a read acquire of the lock.
+ */
+void rwlockReleaseRead(g_rwlock* lock);
+
+/**
+ * Acquires the lock exclusively. Waits for all readers to leave.
+ */
+void rwlockAcquireWrite(g_rwlock* lock);
+
+/**
+ * Releases an exclusive acquire of the lock.
+ */
+void rwlockReleaseWrite(g_rwlock* lock);
+
+#endif
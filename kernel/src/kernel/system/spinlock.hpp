@@ -30,4 +30,34 @@ typedef int g_spinlock;
 #define G_SPINLOCK_RELEASE(lock)                          \
       do { __sync_synchronize(); lock = 0; } while(0)
 
+/**
+ * Fair spinlock: each acquirer draws a ticket and waits until it is served, so
+ * the lock is handed over in arrival order and waiters only read the counter.
+ */
+typedef struct
+{
+    volatile unsigned int next;
+    volatile unsigned int serving;
+} g_ticket_spinlock;
+
+#define G_TICKET_SPINLOCK_INITIALIZER {0, 0}
+
+/**
+ * Draws a ticket for the lock.
+ */
+#define G_TICKET_SPINLOCK_DRAW(lock)                      \
+      __sync_fetch_and_add(&(lock).next, 1)
+
+/**
+ * Number of waiters before the holder of the given ticket, 0 once it is served.
+ */
+#define G_TICKET_SPINLOCK_AHEAD(lock, ticket)             \
+      ((ticket) - (lock).serving)
+
+/**
+ * Hands the lock to the next ticket, may only be done by the holder.
+ */
+#define G_TICKET_SPINLOCK_RELEASE(lock)                   \
+      do { __sync_synchronize(); (lock).serving = (lock).serving + 1; } while(0)
+
 #endif
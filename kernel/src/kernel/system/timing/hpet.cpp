@@ -26,7 +26,6 @@
 static volatile uint64_t* mmio = nullptr;
 static bool available = false;
 static uint64_t frequency = HPET_DEFAULT_FREQUENCY;
-static double periodsPerSecond = 1.0 / frequency;
 
 void _hpetFindAndMap();
 
@@ -40,8 +39,7 @@ void hpetInitialize()
 		// Read correct frequency
 		uint64_t capabilities = mmio[HPET_GEN_CAP_REG / 8];
 		uint32_t clockPeriod = (capabilities >> 32) & 0xFFFFFFFF;
-		frequency = (1000000000000000.0 / clockPeriod); // TODO now on x86_64 do it properly
-		periodsPerSecond = 1.0 / frequency;
+		frequency = 1000000000000000ULL / clockPeriod;
 
 		// Make sure it is enabled
 		mmio[HPET_GEN_CONFIG_REG / 8] |= 1;
@@ -87,5 +85,5 @@ uint64_t hpetGetNanos()
 		return 0;
 
 	uint64_t counterValue = mmio[HPET_MAIN_COUNTER_REG / 8];
-	return (uint64_t) ((double) counterValue * periodsPerSecond * 1000000000);
+	return (counterValue / frequency) * 1000000000 + (counterValue % frequency) * 1000000000 / frequency;
 }
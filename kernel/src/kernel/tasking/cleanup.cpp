@@ -18,9 +18,8 @@
  *                                                                           *
  * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
 
-#include "kernel/memory/heap.hpp"
-#include "kernel/tasking/clock.hpp"
 #include "kernel/tasking/tasking.hpp"
+#include "kernel/tasking/scheduler/scheduler.hpp"
 #include "kernel/system/interrupts/interrupts.hpp"
 
 void taskingCleanupThread()
@@ -29,57 +28,26 @@ void taskingCleanupThread()
 	g_task* self = taskingGetCurrentTask();
 	for(;;)
 	{
-		// Find and remove dead tasks from local scheduling list
-		mutexAcquire(&local->lock);
+		// Destroy tasks that the scheduler has queued as dead
+		g_task* task;
+		while((task = schedulerTakeDead(local)) != nullptr)
+			taskingDestroyTask(task);
 
-		g_schedule_entry* deadList = nullptr;
-		g_schedule_entry* entry = local->scheduling.list;
-		g_schedule_entry* previous = nullptr;
-		while(entry)
+		// Wait until the next task dies
+		INTERRUPTS_PAUSE;
+		mutexAcquire(&local->lock);
+		bool idle = local->scheduling.dead.head == nullptr;
+		if(idle)
 		{
-			g_schedule_entry* next = entry->next;
-
-			auto task = entry->task;
-			mutexAcquire(&task->lock);
-
-			if(task->status == G_TASK_STATUS_DEAD)
-			{
-				if(previous)
-					previous->next = next;
-				else
-					local->scheduling.list = next;
-
-				entry->next = deadList;
-				deadList = entry;
-			}
-			else
-			{
-				previous = entry;
-			}
-			entry = next;
-
-			mutexRelease(&task->lock);
+			mutexAcquire(&self->lock);
+			self->status = G_TASK_STATUS_WAITING;
+			self->waitsFor = "cleanup";
+			mutexRelease(&self->lock);
 		}
-
 		mutexRelease(&local->lock);
 
-		// Remove each task
-		while(deadList)
-		{
-			g_schedule_entry* next = deadList->next;
-			taskingDestroyTask(deadList->task);
-			heapFree(deadList);
-			deadList = next;
-		}
-
-		// Sleep for some time
-		INTERRUPTS_PAUSE;
-		mutexAcquire(&self->lock);
-		self->status = G_TASK_STATUS_WAITING;
-		self->waitsFor = "cleanup-sleep";
-		mutexRelease(&self->lock);
-		clockWaitForTime(self->id, clockGetLocal()->time + 3000);
-		taskingYield();
+		if(idle)
+			taskingYield();
 		INTERRUPTS_RESUME;
 	}
 }
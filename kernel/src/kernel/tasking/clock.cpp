@@ -23,30 +23,72 @@
 #include "kernel/system/configuration.hpp"
 #include "kernel/system/processor/processor.hpp"
 #include "kernel/system/timing/hpet.hpp"
+#include "kernel/system/timing/pit.hpp"
+#include "kernel/system/interrupts/apic/lapic.hpp"
 #include "kernel/tasking/tasking.hpp"
 #include "kernel/panic.hpp"
 #include "kernel/logger/logger.hpp"
 
 static g_clock_local* locals = nullptr;
 
+// Timestamp counter ticks per millisecond as measured during initialization
+static uint64_t tscTicksPerMillisecond = 0;
+
+void _clockCalibrateTsc();
+void clockUpdateTime(g_clock_local* local, bool timerTick);
+
 void clockInitialize()
 {
+	_clockCalibrateTsc();
+
 	uint32_t numProcs = processorGetNumberOfProcessors();
-	locals = (g_clock_local*) heapAllocate(sizeof(g_clock_local) * numProcs);
+	locals = (g_clock_local*) heapAllocateClear(sizeof(g_clock_local) * numProcs);
 
 	for(uint32_t i = 0; i < numProcs; i++)
 	{
 		mutexInitializeGlobal(&locals[i].lock, __func__);
-		locals[i].waiters = nullptr;
+		locals[i].wheel.count = 0;
+		locals[i].wheel.time = 1;
 		locals[i].time = 0;
 		locals[i].lastNanoTime = 0;
 		locals[i].lastRecalibrateMilliTime = 0;
+		locals[i].timerArmed = 0;
+		locals[i].timerCarry = 0;
+		locals[i].timerReadTsc = processorReadTsc();
 #if G_DEBUG_THREAD_DUMPING
 		locals[i].lastLogTime = 0;
 #endif
 	}
 }
 
+void _clockCalibrateTsc()
+{
+	pitPrepareSleep(10000);
+	uint64_t start = processorReadTsc();
+	pitPerformSleep();
+	uint64_t end = processorReadTsc();
+
+	tscTicksPerMillisecond = (end - start) / 10;
+	if(tscTicksPerMillisecond == 0)
+		tscTicksPerMillisecond = 1;
+	logDebug("%! timestamp counter runs at %i ticks per ms", "clock", tscTicksPerMillisecond);
+}
+
+uint64_t clockTscToNanos(uint64_t ticks)
+{
+	return (ticks / tscTicksPerMillisecond) * 1000000 + (ticks % tscTicksPerMillisecond) * 1000000 / tscTicksPerMillisecond;
+}
+
+uint64_t clockGetTime()
+{
+	auto local = clockGetLocal();
+	mutexAcquire(&local->lock);
+	clockUpdateTime(local, false);
+	uint64_t time = local->time;
+	mutexRelease(&local->lock);
+	return time;
+}
+
 g_clock_local* clockGetLocal()
 {
 	if(!locals)
@@ -55,65 +97,193 @@ g_clock_local* clockGetLocal()
 	return &locals[processorGetCurrentId()];
 }
 
-void clockWaitForTime(g_tid task, uint64_t wakeTime)
+/**
+ * Puts the waiter into the slot for its wake time. The level is chosen by how far the
+ * wake time is from the next unprocessed millisecond, on the higher levels the waiter
+ * is moved down once the wheel reaches the range of its slot.
+ */
+void _clockWheelInsert(g_clock_local* local, g_clock_waiter* waiter)
 {
-	auto local = clockGetLocal();
-	mutexAcquire(&local->lock);
+	uint64_t base = local->wheel.time;
+	uint64_t placeTime = waiter->wakeTime > base ? waiter->wakeTime : base;
+
+	int level = 0;
+	while(level < G_CLOCK_WHEEL_LEVELS - 1 &&
+	      placeTime - base >= (1ULL << (G_CLOCK_WHEEL_SLOT_BITS * (level + 1))))
+		level++;
+
+	// Waits beyond the range of the wheel are placed at its end and moved again later
+	uint64_t range = 1ULL << (G_CLOCK_WHEEL_SLOT_BITS * G_CLOCK_WHEEL_LEVELS);
+	if(placeTime - base >= range)
+		placeTime = base + range - 1;
+
+	uint32_t index = (placeTime >> (G_CLOCK_WHEEL_SLOT_BITS * level)) & G_CLOCK_WHEEL_SLOT_MASK;
+	uint32_t slot = level * G_CLOCK_WHEEL_SLOTS + index;
+
+	waiter->previous = nullptr;
+	waiter->next = local->wheel.slots[slot];
+	if(waiter->next)
+		waiter->next->previous = waiter;
+	local->wheel.slots[slot] = waiter;
+	local->wheel.occupied[level] |= 1ULL << index;
+
+	waiter->clock = local;
+	waiter->slot = slot;
+	local->wheel.count++;
+}
+
+void _clockWheelRemove(g_clock_local* local, g_clock_waiter* waiter)
+{
+	if(waiter->previous)
+		waiter->previous->next = waiter->next;
+	else
+		local->wheel.slots[waiter->slot] = waiter->next;
+	if(waiter->next)
+		waiter->next->previous = waiter->previous;
+
+	if(!local->wheel.slots[waiter->slot])
+		local->wheel.occupied[waiter->slot / G_CLOCK_WHEEL_SLOTS] &= ~(1ULL << (waiter->slot & G_CLOCK_WHEEL_SLOT_MASK));
 
-	g_clock_waiter* waiter = (g_clock_waiter*) heapAllocate(sizeof(g_clock_waiter));
-	waiter->task = task;
-	waiter->wakeTime = wakeTime;
 	waiter->next = nullptr;
+	waiter->previous = nullptr;
+	waiter->clock = nullptr;
+	local->wheel.count--;
+}
+
+/**
+ * Moves the waiters of a slot back into the wheel, relative to the current wheel time.
+ */
+void _clockWheelCascade(g_clock_local* local, uint32_t slot)
+{
+	g_clock_waiter* waiter = local->wheel.slots[slot];
+	local->wheel.slots[slot] = nullptr;
+	local->wheel.occupied[slot / G_CLOCK_WHEEL_SLOTS] &= ~(1ULL << (slot & G_CLOCK_WHEEL_SLOT_MASK));
 
-	if(local->waiters)
+	while(waiter)
 	{
-		g_clock_waiter* prev = nullptr;
-		g_clock_waiter* entry = local->waiters;
-		while(entry)
-		{
-			// Insert in middle
-			if(entry->wakeTime > wakeTime)
-			{
-				waiter->next = entry;
-				if(prev)
-					prev->next = waiter;
-				else
-					local->waiters = waiter;
-				break;
-			}
-			prev = entry;
-			entry = entry->next;
+		g_clock_waiter* next = waiter->next;
+		local->wheel.count--;
+		_clockWheelInsert(local, waiter);
+		waiter = next;
+	}
+}
 
-			// Insert at tail
-			if(!entry)
-				prev->next = waiter;
-		}
+/**
+ * @return the earliest time at which the wheel must be processed again, which is either
+ * the wake time of a waiter or the time when a slot of a higher level is moved down
+ */
+uint64_t _clockWheelGetNextTime(g_clock_local* local)
+{
+	uint64_t next = UINT64_MAX;
+	uint64_t processed = local->wheel.time - 1;
+
+	for(int level = 0; level < G_CLOCK_WHEEL_LEVELS; level++)
+	{
+		uint64_t occupied = local->wheel.occupied[level];
+		if(!occupied)
+			continue;
+
+		// Search the slots in the order in which the wheel reaches them
+		int shift = G_CLOCK_WHEEL_SLOT_BITS * level;
+		uint32_t start = ((processed >> shift) + 1) & G_CLOCK_WHEEL_SLOT_MASK;
+		uint64_t rotated = (occupied >> start) | (start ? occupied << (G_CLOCK_WHEEL_SLOTS - start) : 0);
+		uint64_t distance = __builtin_ctzll(rotated);
+
+		uint64_t time = ((processed >> shift) + distance + 1) << shift;
+		if(time < next)
+			next = time;
+	}
+	return next;
+}
+
+void clockWaitForTime(g_task* task, uint64_t wakeTime)
+{
+	auto local = clockGetLocal();
+	clockUnwaitForTime(task);
+
+	mutexAcquire(&local->lock);
+	if(wakeTime <= local->time)
+	{
+		taskingWake(task);
 	}
 	else
 	{
-		// Insert at head
-		local->waiters = waiter;
+		task->clockWaiter.wakeTime = wakeTime;
+		_clockWheelInsert(local, &task->clockWaiter);
 	}
-
 	mutexRelease(&local->lock);
 }
 
 void clockWakeWaiters(g_clock_local* local)
 {
-	while(local->waiters && local->time >= local->waiters->wakeTime)
+	while(local->wheel.time <= local->time)
 	{
-		g_task* task = taskingGetById(local->waiters->task);
-		taskingWake(task);
+		if(local->wheel.count == 0)
+		{
+			local->wheel.time = local->time + 1;
+			break;
+		}
+
+		uint64_t now = local->wheel.time;
+
+		// When a level has passed through all its slots, the next slot of the level above is due
+		for(int level = 1; level < G_CLOCK_WHEEL_LEVELS; level++)
+		{
+			int shift = G_CLOCK_WHEEL_SLOT_BITS * level;
+			if(now & ((1ULL << shift) - 1))
+				break;
+			_clockWheelCascade(local, level * G_CLOCK_WHEEL_SLOTS + ((now >> shift) & G_CLOCK_WHEEL_SLOT_MASK));
+		}
+
+		g_clock_waiter* waiter;
+		while((waiter = local->wheel.slots[now & G_CLOCK_WHEEL_SLOT_MASK]) != nullptr)
+		{
+			_clockWheelRemove(local, waiter);
+			taskingWake(waiter->task);
+		}
 
-		auto next = local->waiters->next;
-		heapFree(local->waiters);
-		local->waiters = next;
+		local->wheel.time++;
 	}
 }
 
-void clockUpdateTime(g_clock_local* local)
+/**
+ * Adds the time that has passed since the timer was last armed or read. The LAPIC
+ * timer runs in one-shot mode, so the elapsed time is read from its counter. The
+ * PIT keeps firing periodically, so each interrupt is one period.
+ */
+void clockAdvance(g_clock_local* local, bool timerTick)
 {
-	local->time += (1000 / G_TIMER_FREQUENCY);
+	uint32_t ticksPerMillisecond = lapicTimerGetTicksPerMillisecond();
+	if(!lapicIsAvailable() || !ticksPerMillisecond)
+	{
+		if(timerTick)
+			local->time += (1000 / G_TIMER_FREQUENCY);
+		return;
+	}
+
+	uint64_t tscNow = processorReadTsc();
+	uint32_t remaining = lapicTimerGetRemaining();
+	uint64_t elapsed = local->timerCarry;
+	if(local->timerArmed > remaining)
+		elapsed += local->timerArmed - remaining;
+
+	// Add the time that passed after the timer expired
+	if(remaining == 0)
+	{
+		uint64_t measured = (tscNow - local->timerReadTsc) * ticksPerMillisecond / tscTicksPerMillisecond;
+		if(measured > local->timerArmed)
+			elapsed += measured - local->timerArmed;
+	}
+	local->timerReadTsc = tscNow;
+
+	local->time += elapsed / ticksPerMillisecond;
+	local->timerCarry = elapsed % ticksPerMillisecond;
+	local->timerArmed = remaining;
+}
+
+void clockUpdateTime(g_clock_local* local, bool timerTick)
+{
+	clockAdvance(local, timerTick);
 
 	// Use HPET timing if available
 	if(hpetIsAvailable())
@@ -123,7 +293,7 @@ void clockUpdateTime(g_clock_local* local)
 		{
 			uint64_t now = hpetGetNanos();
 			uint64_t elapsedNanos = now - local->lastNanoTime;
-			uint64_t elapsedMillis = ((double) elapsedNanos / 1000000);
+			uint64_t elapsedMillis = elapsedNanos / 1000000;
 			local->time = local->lastRecalibrateMilliTime + elapsedMillis;
 			local->lastNanoTime = now;
 			local->lastRecalibrateMilliTime = local->time;
@@ -131,63 +301,80 @@ void clockUpdateTime(g_clock_local* local)
 	}
 }
 
-void clockUpdate()
+void clockUpdate(bool timerTick)
 {
 	auto local = clockGetLocal();
 	mutexAcquire(&local->lock);
-	clockUpdateTime(local);
+	clockUpdateTime(local, timerTick);
 	clockWakeWaiters(local);
 	mutexRelease(&local->lock);
 }
 
-void clockUnwaitForTime(g_tid task)
+void clockArmTimer(uint32_t milliseconds)
 {
+	uint32_t ticksPerMillisecond = lapicTimerGetTicksPerMillisecond();
+	if(!lapicIsAvailable() || !ticksPerMillisecond)
+		return;
+
 	auto local = clockGetLocal();
 	mutexAcquire(&local->lock);
 
-	g_clock_waiter* prev = nullptr;
-	g_clock_waiter* entry = local->waiters;
-	while(entry)
+	// Account what has elapsed before restarting the counter
+	clockAdvance(local, false);
+
+	if(local->wheel.count)
 	{
-		if(entry->task == task)
-		{
-			auto next = entry->next;
-			if(prev)
-				prev->next = next;
-			else
-				local->waiters = next;
-
-			heapFree(entry);
-			entry = next;
-		}
-		else
-		{
-			prev = entry;
-			entry = entry->next;
-		}
+		uint64_t nextTime = _clockWheelGetNextTime(local);
+		uint64_t untilWake = nextTime > local->time ? nextTime - local->time : 0;
+		if(untilWake < milliseconds)
+			milliseconds = untilWake;
 	}
 
+	if(milliseconds < 1)
+		milliseconds = 1;
+	if(milliseconds > 0xFFFFFFFF / ticksPerMillisecond)
+		milliseconds = 0xFFFFFFFF / ticksPerMillisecond;
+
+	// The fraction of a millisecond that already passed is subtracted to stay on the millisecond grid
+	local->timerArmed = milliseconds * ticksPerMillisecond - local->timerCarry;
+	lapicTimerArm(local->timerArmed);
+
 	mutexRelease(&local->lock);
 }
 
-bool clockHasTimedOut(g_tid task)
+void clockUnwaitForTime(g_task* task)
 {
-	auto local = clockGetLocal();
-	mutexAcquire(&local->lock);
+	g_clock_waiter* waiter = &task->clockWaiter;
 
-	bool timeout = true;
-
-	g_clock_waiter* entry = local->waiters;
-	while(entry)
+	// The waiter may be woken or queued elsewhere until the lock of its clock is acquired
+	g_clock_local* clock;
+	while((clock = waiter->clock) != nullptr)
 	{
-		if(entry->task == task && local->time < entry->wakeTime)
-		{
-			timeout = false;
+		mutexAcquire(&clock->lock);
+		bool queued = waiter->clock == clock;
+		if(queued)
+			_clockWheelRemove(clock, waiter);
+		mutexRelease(&clock->lock);
+
+		if(queued)
 			break;
-		}
-		entry = entry->next;
 	}
+}
 
-	mutexRelease(&local->lock);
-	return timeout;
+bool clockHasTimedOut(g_task* task)
+{
+	g_clock_waiter* waiter = &task->clockWaiter;
+
+	g_clock_local* clock;
+	while((clock = waiter->clock) != nullptr)
+	{
+		mutexAcquire(&clock->lock);
+		bool queued = waiter->clock == clock;
+		bool timeout = queued && clock->time >= waiter->wakeTime;
+		mutexRelease(&clock->lock);
+
+		if(queued)
+			return timeout;
+	}
+	return true;
 }
@@ -31,11 +31,37 @@
  */
 #define G_CLOCK_RECALIBRATION_INTERVAL   1000
 
+/**
+ * Size of the timer wheel for waiting tasks. Each level has a number of slots that
+ * each cover the full range of the level below, one millisecond per slot on the
+ * lowest level. With 4 levels of 64 slots, waits of up to ~4.6 hours are placed
+ * directly; longer waits are moved down the wheel until they are due.
+ */
+#define G_CLOCK_WHEEL_LEVELS        4
+#define G_CLOCK_WHEEL_SLOT_BITS     6
+#define G_CLOCK_WHEEL_SLOTS         (1 << G_CLOCK_WHEEL_SLOT_BITS)
+#define G_CLOCK_WHEEL_SLOT_MASK     (G_CLOCK_WHEEL_SLOTS - 1)
+
+struct g_task;
+struct g_clock_local;
+
+/**
+ * Entry of a task in the timer wheel. Each task embeds one waiter, so waiting for
+ * a time does not allocate and can be cancelled without searching.
+ */
 struct g_clock_waiter
 {
-    g_tid task;
+    g_task* task;
     uint64_t wakeTime;
     g_clock_waiter* next;
+    g_clock_waiter* previous;
+
+    /**
+     * Clock that this waiter is queued in and index of its slot in the wheel,
+     * or null if the waiter is not queued.
+     */
+    g_clock_local* clock;
+    uint32_t slot;
 };
 
 /**
@@ -43,9 +69,24 @@ struct g_clock_waiter
  */
 struct g_clock_local
 {
-    g_clock_waiter* waiters;
     g_mutex lock;
 
+    /**
+     * Waiting tasks, sorted into slots by their wake time. The occupied masks have
+     * a bit set for each slot that is not empty.
+     */
+    struct
+    {
+        g_clock_waiter* slots[G_CLOCK_WHEEL_LEVELS * G_CLOCK_WHEEL_SLOTS];
+        uint64_t occupied[G_CLOCK_WHEEL_LEVELS];
+        uint32_t count;
+
+        /**
+         * Next millisecond that was not yet processed.
+         */
+        uint64_t time;
+    } wheel;
+
     /**
      * Milliseconds that this processor has run.
      */
@@ -57,6 +98,20 @@ struct g_clock_local
     uint64_t lastNanoTime;
     uint64_t lastRecalibrateMilliTime;
 
+    /**
+     * Ticks of the one-shot timer that were not yet added to the time and the
+     * fraction of a millisecond that is left over from previous updates.
+     */
+    uint32_t timerArmed;
+    uint32_t timerCarry;
+
+    /**
+     * Timestamp counter value when the timer was last armed or read. Once the
+     * one-shot timer has expired its counter stays at zero, the time that passed
+     * since then is measured with the timestamp counter.
+     */
+    uint64_t timerReadTsc;
+
 #if G_DEBUG_THREAD_DUMPING
     uint64_t lastLogTime;
 #endif
@@ -73,25 +128,49 @@ void clockInitialize();
 g_clock_local* clockGetLocal();
 
 /**
- * Adds the task to the queue of tasks that are waiting for a specific time. This
- * queue is ordered ascending by the time of wake-up.
+ * Brings the time of this processor up to date and returns it. With the one-shot
+ * timer, the time only advances on interrupts, so this must be used as the base
+ * for timeouts instead of reading the time directly.
+ *
+ * @return the current time in milliseconds
+ */
+uint64_t clockGetTime();
+
+/**
+ * Converts a difference of timestamp counter values to nanoseconds. The counter
+ * frequency is measured once during initialization.
+ */
+uint64_t clockTscToNanos(uint64_t ticks);
+
+/**
+ * Adds the task to the timer wheel of this processor so that it is woken at the given
+ * time. A task only waits for one time, a previous wait is replaced. If the time has
+ * already passed, the task is woken immediately.
+ */
+void clockWaitForTime(g_task* task, uint64_t wakeTime);
+
+/**
+ * Brings the local time up to date and wakes all tasks on top of the wait queue
+ * for which the wake-up time is lower than the current. With a periodic timer,
+ * time only advances on timer interrupts.
  */
-void clockWaitForTime(g_tid task, uint64_t wakeTime);
+void clockUpdate(bool timerTick);
 
 /**
- * Called when the local time has changed. Wakes all tasks on top of the wait queue
- * for which the wake-up time is lower than the current.
+ * Arms the timer of the current processor to interrupt after the given number of
+ * milliseconds, or earlier if a waiting task must be woken before. Does nothing if
+ * the timer can only run periodically.
  */
-void clockUpdate();
+void clockArmTimer(uint32_t milliseconds);
 
 /**
- * Removes the task from the wake queue.
+ * Removes the task from the timer wheel it is waiting in.
  */
-void clockUnwaitForTime(g_tid task);
+void clockUnwaitForTime(g_task* task);
 
 /**
- * @returns true when the wake-up time for this task was reached or the queue entry removed.
+ * @returns true when the wake-up time for this task was reached or the wait removed.
  */
-bool clockHasTimedOut(g_tid task);
+bool clockHasTimedOut(g_task* task);
 
 #endif
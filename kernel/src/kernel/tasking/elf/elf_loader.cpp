@@ -53,6 +53,7 @@ g_load_executable_result elfLoadExecutable(g_fd fd, g_security_level securityLev
 		g_address imageEnd = elfUserProcessCreateInfo(process, rootRes.object, rootRes.nextFreeBase, securityLevel);
 
 		process->object = rootRes.object;
+		process->object->references = 1;
 		process->image.start = rootRes.object->startAddress;
 		process->image.end = imageEnd;
 
@@ -54,6 +54,10 @@ struct g_elf_object
 	bool root;
 	char* name;
 
+	// Number of processes using this object, only used on the root. Forked
+	// processes share the root object of their parent.
+	int references;
+
 	Elf64_Ehdr header;
 	g_elf_dependency* dependencies;
 
@@ -23,25 +23,107 @@
 
 #include "kernel/tasking/tasking.hpp"
 
+/**
+ * Time in milliseconds that a task may run without waiting before it is
+ * demoted to the next lower level.
+ */
+#define G_SCHEDULER_DEMOTION_TIME 20
+
+/**
+ * Interval in milliseconds in which each processor compares its load to the other
+ * processors and pulls over a task from the busiest one if necessary.
+ */
+#define G_SCHEDULER_BALANCE_INTERVAL 100
+
+/**
+ * Interval in milliseconds in which demoted tasks are moved back to the level
+ * of their priority.
+ */
+#define G_SCHEDULER_BOOST_INTERVAL 1000
+
 /**
  * Initializes the scheduler locally.
  */
 void schedulerInitializeLocal();
 
 /**
- * Prepares a new task entry for scheduling.
+ * Creates a new entry for scheduling the task.
+ */
+g_schedule_entry* schedulerCreateEntry(g_task* task);
+
+/**
+ * Adds an entry to the run queue of the local. The local lock must be held.
+ */
+void schedulerAddEntry(g_tasking_local* local, g_schedule_entry* entry);
+
+/**
+ * Removes an entry from whichever scheduling queue of the local it is in. The
+ * local lock must be held.
+ */
+void schedulerRemoveEntry(g_tasking_local* local, g_schedule_entry* entry);
+
+/**
+ * Called after a task has changed into the running state, puts the task back
+ * into the run queue of its processor on the level of its priority.
+ */
+void schedulerNotifyRunnable(g_task* task);
+
+/**
+ * Arms the timer of the current processor if a task became runnable on it that
+ * needs the slice timer. Must be called after the local lock was released.
+ */
+void schedulerArmPendingTimer();
+
+/**
+ * Called after a task has died. Unless it is currently running, the task is moved
+ * to the dead queue of its processor and the cleanup task is woken to destroy it.
+ * Running tasks are moved there once they are switched away from.
+ */
+void schedulerNotifyDead(g_task* task);
+
+/**
+ * Takes the next task from the dead queue of the local and removes its entry.
+ *
+ * @return the task to destroy or null if there is none
+ */
+g_task* schedulerTakeDead(g_tasking_local* local);
+
+/**
+ * @return the number of tasks in the run queues of the local
+ */
+int schedulerGetLoad(g_tasking_local* local);
+
+/**
+ * Sets the priority of a task and moves it to the respective run queue.
+ */
+void schedulerSetPriority(g_task* task, g_task_priority priority);
+
+/**
+ * @return the priority that a task has if none is set explicitly
+ */
+g_task_priority schedulerGetDefaultPriority(g_task* task);
+
+/**
+ * @return the run queue level for a priority, where 0 is the highest
  */
-void schedulerPrepareEntry(g_schedule_entry* entry);
+int schedulerGetPriorityLevel(g_task_priority priority);
 
 /**
- * Applies the given task as the current one.
+ * Applies the given task as the current one and arms the timer for its time slice.
  */
 void schedulerSetCurrent(g_tasking_local* local, g_task* task);
 
 /**
- * Schedules to the next task.
+ * Schedules to the next task. On a timer tick the current task continues
+ * as long as its time slice is not used up and no higher level task is ready.
+ *
+ * Afterwards the timer is armed for the end of the time slice. If no other task
+ * is waiting to run, the timer is armed as late as possible instead.
+ *
+ * When there is nothing left to run, or periodically when the load is uneven,
+ * a task is pulled over from the busiest other processor.
  */
-void schedulerSchedule(g_tasking_local* local);
+void schedulerSchedule(g_tasking_local* local, bool timerTick);
 
 /**
  * Log information about all current tasks.
@@ -49,8 +131,12 @@ void schedulerSchedule(g_tasking_local* local);
 void schedulerDump();
 
 /**
- * Sets a task as the "preferred task" for scheduling.
+ * Hands the processor over to the given task once the current task yields or
+ * waits. This only applies if the task is runnable on the current processor and
+ * no task of a higher level is waiting; the task then runs on the rest of the
+ * time slice of the current task, so that handing over back and forth can not
+ * be used to get more processing time.
  */
-void schedulerPrefer(g_tid task);
+void schedulerPrefer(g_task* task);
 
 #endif
@@ -22,129 +22,690 @@
 #include "kernel/logger/logger.hpp"
 
 #include "kernel/tasking/clock.hpp"
+#include "kernel/memory/object_cache.hpp"
+#include "kernel/system/configuration.hpp"
 #include "kernel/system/processor/processor.hpp"
+#include "kernel/system/interrupts/interrupts.hpp"
 #include "kernel/tasking/tasking_directory.hpp"
+#include "kernel/panic.hpp"
 
 #define G_DEBUG_LOG_PAUSE 5000
 
 /**
- * The "preferred task" is just a hint to scheduling that it would make sense to
- * switch to a specific task. It is checked on all cores.
+ * Time in milliseconds that a task may run on each level before it is switched.
  */
-g_tid preferredTask;
+static const uint64_t schedulerSliceTimes[G_SCHEDULER_LEVELS] = {1, 2, 4, 8};
+
+static g_object_cache schedulerEntryCache = G_OBJECT_CACHE_INITIALIZER("schedule-entry", g_schedule_entry);
 
 void schedulerInitializeLocal()
 {
-	preferredTask = G_TID_NONE;
+	taskingGetLocal()->scheduling.lastBoostTime = 0;
+	taskingGetLocal()->scheduling.lastBalanceTime = 0;
+	taskingGetLocal()->scheduling.lastScheduleTime = 0;
+}
+
+g_schedule_entry* schedulerCreateEntry(g_task* task)
+{
+	auto entry = (g_schedule_entry*) objectCacheAllocate(&schedulerEntryCache);
+	entry->task = task;
+	entry->next = nullptr;
+	entry->previous = nullptr;
+	entry->queue = nullptr;
+	return entry;
+}
+
+void _schedulerQueuePush(g_schedule_queue* queue, g_schedule_entry* entry)
+{
+	entry->queue = queue;
+	entry->next = nullptr;
+	entry->previous = queue->tail;
+	if(queue->tail)
+		queue->tail->next = entry;
+	else
+		queue->head = entry;
+	queue->tail = entry;
+	queue->count++;
+}
+
+void _schedulerQueueRemove(g_schedule_entry* entry)
+{
+	g_schedule_queue* queue = entry->queue;
+	if(!queue)
+		return;
+
+	if(entry->previous)
+		entry->previous->next = entry->next;
+	else
+		queue->head = entry->next;
+
+	if(entry->next)
+		entry->next->previous = entry->previous;
+	else
+		queue->tail = entry->previous;
+
+	queue->count--;
+	entry->next = nullptr;
+	entry->previous = nullptr;
+	entry->queue = nullptr;
+}
+
+/**
+ * @return the run queue level of the entry or -1 if it is not in a run queue of the local
+ */
+int _schedulerGetRunnableLevel(g_tasking_local* local, g_schedule_entry* entry)
+{
+	g_schedule_queue* queue = entry->queue;
+	if(queue >= &local->scheduling.runnable[0] && queue < &local->scheduling.runnable[G_SCHEDULER_LEVELS])
+		return queue - &local->scheduling.runnable[0];
+	return -1;
+}
+
+/**
+ * Moves the entry to the tail of the run queue on the given level.
+ */
+void _schedulerMoveToLevel(g_tasking_local* local, g_schedule_entry* entry, int level)
+{
+	_schedulerQueueRemove(entry);
+	_schedulerQueuePush(&local->scheduling.runnable[level], entry);
+	entry->task->scheduling.level = level;
+	entry->task->scheduling.levelTime = 0;
+}
+
+int schedulerGetPriorityLevel(g_task_priority priority)
+{
+	switch(priority)
+	{
+		case G_TASK_PRIORITY_HIGH:
+			return 0;
+		case G_TASK_PRIORITY_LOW:
+			return 2;
+		case G_TASK_PRIORITY_IDLE:
+			return 3;
+		default:
+			return 1;
+	}
+}
+
+g_task_priority schedulerGetDefaultPriority(g_task* task)
+{
+	if(task->securityLevel <= G_SECURITY_LEVEL_DRIVER || task->type == G_TASK_TYPE_VITAL)
+		return G_TASK_PRIORITY_HIGH;
+	return G_TASK_PRIORITY_NORMAL;
+}
+
+/**
+ * Returns the lowest level that the task may be demoted to. Tasks are never demoted
+ * into the level of idle priority.
+ */
+int _schedulerGetLowestLevel(g_task* task)
+{
+	int base = schedulerGetPriorityLevel(task->scheduling.priority);
+	int lowest = schedulerGetPriorityLevel(G_TASK_PRIORITY_LOW);
+	return base > lowest ? base : lowest;
+}
+
+/**
+ * Interrupts the processor of the local if a task that became runnable there should
+ * run before the current task, or if the timer was armed for the longest interval
+ * but the processor now has to be shared. The local lock must be held.
+ *
+ * The current processor can't interrupt itself, instead its timer is armed to expire
+ * right away once the lock is released.
+ */
+void _schedulerRequestPreemption(g_tasking_local* local, g_task* task)
+{
+	if(local->scheduling.reschedulePending)
+		return;
+
+	g_task* current = local->scheduling.current;
+	bool preempt = !current || current == local->scheduling.idleTask || current->scheduling.level > task->scheduling.level;
+	bool rearm = local->scheduling.longInterval && schedulerGetLoad(local) > 1;
+	if(!preempt && !rearm)
+		return;
+
+	local->scheduling.longInterval = false;
+	if(local->processor == processorGetCurrentId())
+	{
+		local->scheduling.rearmPending = true;
+	}
+	else
+	{
+		local->scheduling.reschedulePending = true;
+		interruptsSendReschedule(local->processor);
+	}
+}
+
+void schedulerArmPendingTimer()
+{
+	INTERRUPTS_PAUSE;
+	g_tasking_local* local = taskingGetLocal();
+	bool rearm = local->scheduling.rearmPending;
+	local->scheduling.rearmPending = false;
+	INTERRUPTS_RESUME;
+
+	// The next timer interrupt decides whether the current task may continue
+	if(rearm)
+		clockArmTimer(1);
+}
+
+void schedulerAddEntry(g_tasking_local* local, g_schedule_entry* entry)
+{
+	g_task* task = entry->task;
+	task->scheduling.level = schedulerGetPriorityLevel(task->scheduling.priority);
+	task->scheduling.levelTime = 0;
+	_schedulerQueuePush(&local->scheduling.runnable[task->scheduling.level], entry);
+	_schedulerRequestPreemption(local, task);
+}
+
+int schedulerGetLoad(g_tasking_local* local)
+{
+	int load = 0;
+	for(int level = 0; level < G_SCHEDULER_LEVELS; level++)
+		load += local->scheduling.runnable[level].count;
+	return load;
+}
+
+/**
+ * Moves the entry of a task that stopped running out of the run queues. Dead tasks
+ * are put into the dead queue for the cleanup task. The local lock must be held.
+ */
+void _schedulerPark(g_tasking_local* local, g_schedule_entry* entry, g_task_status status)
+{
+	_schedulerQueueRemove(entry);
+	_schedulerQueuePush(status == G_TASK_STATUS_DEAD ? &local->scheduling.dead : &local->scheduling.blocked, entry);
+}
+
+/**
+ * Acquires the lock of the local that the task is assigned to. Because tasks may be
+ * moved to a different processor while waiting for the lock, the assignment is checked
+ * again once it is held.
+ *
+ * @return the locked local or null if the task is not assigned
+ */
+g_tasking_local* _schedulerLockAssignment(g_task* task)
+{
+	for(;;)
+	{
+		g_tasking_local* local = task->assignment;
+		if(!local)
+			return nullptr;
+
+		mutexAcquire(&local->lock);
+		if(task->assignment == local)
+			return local;
+		mutexRelease(&local->lock);
+	}
+}
+
+void schedulerRemoveEntry(g_tasking_local* local, g_schedule_entry* entry)
+{
+	if(entry->queue != &local->scheduling.blocked && entry->queue != &local->scheduling.dead &&
+	   _schedulerGetRunnableLevel(local, entry) == -1)
+		panic("%! tried to remove entry of task %i from wrong processor", "scheduler", entry->task->id);
+
+	_schedulerQueueRemove(entry);
+}
+
+void schedulerNotifyRunnable(g_task* task)
+{
+	g_tasking_local* local = _schedulerLockAssignment(task);
+	if(!local)
+		return;
+
+	g_schedule_entry* entry = task->scheduleEntry;
+	if(entry && (entry->queue == &local->scheduling.blocked || _schedulerGetRunnableLevel(local, entry) != -1))
+	{
+		// Tasks that waited are boosted back to the level of their priority
+		int baseLevel = schedulerGetPriorityLevel(task->scheduling.priority);
+		if(entry->queue == &local->scheduling.blocked || task->scheduling.level != baseLevel)
+			_schedulerMoveToLevel(local, entry, baseLevel);
+
+		_schedulerRequestPreemption(local, task);
+	}
+	mutexRelease(&local->lock);
+	schedulerArmPendingTimer();
+}
+
+void schedulerNotifyDead(g_task* task)
+{
+	g_tasking_local* local = _schedulerLockAssignment(task);
+	if(!local)
+		return;
+
+	// The task may be freed once it is cleaned up
+	if(local->scheduling.preferred == task)
+		local->scheduling.preferred = nullptr;
+
+	g_schedule_entry* entry = task->scheduleEntry;
+	bool queued = false;
+	if(task == local->scheduling.current)
+	{
+		// Make the processor switch away so that the task is queued soon
+		if(!local->scheduling.reschedulePending)
+		{
+			local->scheduling.reschedulePending = true;
+			interruptsSendReschedule(local->processor);
+		}
+	}
+	else if(entry && entry->queue != &local->scheduling.dead)
+	{
+		_schedulerPark(local, entry, G_TASK_STATUS_DEAD);
+		queued = true;
+	}
+	mutexRelease(&local->lock);
+
+	if(queued)
+		taskingWake(local->scheduling.cleanupTask);
 }
 
-void schedulerPrepareEntry(g_schedule_entry* entry)
+g_task* schedulerTakeDead(g_tasking_local* local)
+{
+	mutexAcquire(&local->lock);
+
+	g_task* task = nullptr;
+	g_schedule_entry* entry = local->scheduling.dead.head;
+	if(entry)
+	{
+		_schedulerQueueRemove(entry);
+		task = entry->task;
+		task->scheduleEntry = nullptr;
+		objectCacheFree(&schedulerEntryCache, entry);
+	}
+
+	mutexRelease(&local->lock);
+	return task;
+}
+
+void schedulerSetPriority(g_task* task, g_task_priority priority)
+{
+	g_tasking_local* local = _schedulerLockAssignment(task);
+	if(!local)
+	{
+		task->scheduling.priority = priority;
+		task->scheduling.level = schedulerGetPriorityLevel(priority);
+		return;
+	}
+
+	task->scheduling.priority = priority;
+
+	int baseLevel = schedulerGetPriorityLevel(priority);
+	g_schedule_entry* entry = task->scheduleEntry;
+	if(entry && _schedulerGetRunnableLevel(local, entry) != -1)
+		_schedulerMoveToLevel(local, entry, baseLevel);
+	else
+		task->scheduling.level = baseLevel;
+	mutexRelease(&local->lock);
+}
+
+/**
+ * To avoid starvation, all demoted tasks are periodically moved back to the level
+ * of their priority.
+ */
+void _schedulerBoostDemoted(g_tasking_local* local)
 {
+	uint64_t now = clockGetLocal()->time;
+	if(now - local->scheduling.lastBoostTime < G_SCHEDULER_BOOST_INTERVAL)
+		return;
+	local->scheduling.lastBoostTime = now;
+
+	for(int level = 1; level < G_SCHEDULER_LEVELS; level++)
+	{
+		g_schedule_entry* entry = local->scheduling.runnable[level].head;
+		while(entry)
+		{
+			g_schedule_entry* next = entry->next;
+			int baseLevel = schedulerGetPriorityLevel(entry->task->scheduling.priority);
+			if(baseLevel < level)
+				_schedulerMoveToLevel(local, entry, baseLevel);
+			entry = next;
+		}
+	}
 }
 
-g_schedule_entry* schedulerGetNextTask(g_tasking_local* local)
+/**
+ * @return whether any run queue above the given level has entries
+ */
+bool _schedulerHasHigherLevel(g_tasking_local* local, int level)
 {
-	g_schedule_entry* entry = local->scheduling.list;
-	if(local->scheduling.current == local->scheduling.idleTask)
+	for(int i = 0; i < level; i++)
 	{
-		return entry;
+		if(local->scheduling.runnable[i].head)
+			return true;
 	}
+	return false;
+}
+
+/**
+ * @return whether the task may be moved away from the source local; both locals must be locked
+ */
+bool _schedulerIsMigratable(g_tasking_local* source, g_task* task)
+{
+	if(task->coreAffinity != G_TASK_CORE_AFFINITY_NONE || task->type == G_TASK_TYPE_VITAL)
+		return false;
+
+	if(task == source->scheduling.current || task == source->scheduling.interrupted)
+		return false;
 
-	// Check if there is a global "preferred task" to do next
-	// TODO The current yield is not "fair" and makes the system slower
-	if(false && preferredTask != G_TID_NONE)
+	mutexAcquire(&task->lock);
+	bool running = task->status == G_TASK_STATUS_RUNNING;
+	mutexRelease(&task->lock);
+	return running;
+}
+
+/**
+ * Moves one runnable task from the source to the target local. Tasks on the lowest
+ * levels are taken first, as these are the ones that used up most processing time.
+ *
+ * @return whether a task was moved
+ */
+bool _schedulerPullTask(g_tasking_local* target, g_tasking_local* source)
+{
+	// Locks are always taken in processor order so that two processors can pull from each other
+	g_tasking_local* first = target->processor < source->processor ? target : source;
+	g_tasking_local* second = first == target ? source : target;
+	mutexAcquire(&first->lock);
+	mutexAcquire(&second->lock);
+
+	g_schedule_entry* pulled = nullptr;
+	for(int level = G_SCHEDULER_LEVELS - 1; level >= 0 && !pulled; level--)
 	{
+		g_schedule_entry* entry = source->scheduling.runnable[level].tail;
 		while(entry)
 		{
-			if(entry->task->id == preferredTask)
+			if(_schedulerIsMigratable(source, entry->task))
 			{
-				preferredTask = G_TID_NONE;
-				return entry;
+				pulled = entry;
+				break;
 			}
-			entry = entry->next;
+			entry = entry->previous;
 		}
 	}
 
-	// Otherwise just find our current tasks entry and choose the next one
-	while(entry)
+	if(pulled)
+	{
+		g_task* task = pulled->task;
+		_schedulerQueueRemove(pulled);
+		_schedulerQueuePush(&target->scheduling.runnable[task->scheduling.level], pulled);
+		task->assignment = target;
+		task->threadLocal.kernelThreadLocal->processor = target->processor;
+
+		if(source->scheduling.preferred == task)
+			source->scheduling.preferred = nullptr;
+	}
+
+	mutexRelease(&second->lock);
+	mutexRelease(&first->lock);
+	return pulled != nullptr;
+}
+
+/**
+ * Looks for the processor with the highest load and pulls a task from it if its
+ * load is at least the given minimum. The loads of other processors are read without
+ * locking as they are only used as a hint.
+ *
+ * @return whether a task was moved
+ */
+bool _schedulerPullFromBusiest(g_tasking_local* local, int minimumLoad)
+{
+	// Locals are stored in an array indexed by processor
+	g_tasking_local* firstLocal = local - local->processor;
+	g_tasking_local* busiest = nullptr;
+	int busiestLoad = minimumLoad - 1;
+
+	for(uint32_t i = 0; i < processorGetNumberOfProcessors(); i++)
 	{
-		if(entry->task == local->scheduling.current)
+		g_tasking_local* other = &firstLocal[i];
+		if(other == local)
+			continue;
+
+		int load = schedulerGetLoad(other);
+		if(load > busiestLoad)
 		{
-			break;
+			busiestLoad = load;
+			busiest = other;
 		}
-		entry = entry->next;
 	}
-	if(entry)
+
+	return busiest && _schedulerPullTask(local, busiest);
+}
+
+/**
+ * Periodically evens out the load between this and the busiest other processor.
+ */
+void _schedulerBalance(g_tasking_local* local)
+{
+	uint64_t now = clockGetLocal()->time;
+	if(now - local->scheduling.lastBalanceTime < G_SCHEDULER_BALANCE_INTERVAL)
+		return;
+	local->scheduling.lastBalanceTime = now;
+
+	_schedulerPullFromBusiest(local, schedulerGetLoad(local) + 2);
+}
+
+/**
+ * Takes the first runnable task of the highest level. Tasks that stopped running are
+ * moved aside on the way.
+ *
+ * @return the task or null if none is runnable
+ */
+g_task* _schedulerTakeNext(g_tasking_local* local)
+{
+	for(int level = 0; level < G_SCHEDULER_LEVELS; level++)
 	{
-		entry = entry->next;
+		g_schedule_entry* entry;
+		while((entry = local->scheduling.runnable[level].head) != nullptr)
+		{
+			g_task* task = entry->task;
+
+			mutexAcquire(&task->lock);
+			bool runnable = task->status == G_TASK_STATUS_RUNNING;
+			if(!runnable)
+				_schedulerPark(local, entry, task->status);
+			mutexRelease(&task->lock);
+
+			if(runnable)
+				return task;
+		}
 	}
-	if(!entry)
+	return nullptr;
+}
+
+/**
+ * Checks whether the processor can be handed to the preferred task. The local lock
+ * must be held.
+ *
+ * @return the task or null if it may not run now
+ */
+g_task* _schedulerTakePreferred(g_tasking_local* local, g_task* task)
+{
+	if(task->assignment != local || !task->scheduleEntry)
+		return nullptr;
+
+	int level = _schedulerGetRunnableLevel(local, task->scheduleEntry);
+	if(level == -1 || _schedulerHasHigherLevel(local, level))
+		return nullptr;
+
+	mutexAcquire(&task->lock);
+	bool runnable = task->status == G_TASK_STATUS_RUNNING;
+	mutexRelease(&task->lock);
+	return runnable ? task : nullptr;
+}
+
+/**
+ * Also remembers whether the longest interval is used, so that the timer is armed
+ * again once another task becomes runnable. The local lock must be held.
+ *
+ * @return the time in milliseconds after which the processor must schedule again
+ */
+uint32_t _schedulerGetTimerInterval(g_tasking_local* local, g_task* task)
+{
+	local->scheduling.longInterval = task == local->scheduling.idleTask || schedulerGetLoad(local) <= 1;
+	if(local->scheduling.longInterval)
+		return G_TIMER_MAXIMUM_INTERVAL;
+
+	uint64_t slice = schedulerSliceTimes[task->scheduling.level];
+	if(task->scheduling.sliceTime >= slice)
+		return 1;
+	return slice - task->scheduling.sliceTime;
+}
+
+/**
+ * Remembers when the previous task started waiting and accounts the time
+ * that the next task has waited until it runs again.
+ */
+void _schedulerAccountWaiting(g_task* previous, g_task* next)
+{
+	if(previous == next)
+		return;
+
+	uint64_t now = processorReadTsc();
+	if(previous && previous->status == G_TASK_STATUS_WAITING)
+		previous->statistics.waitStart = now;
+
+	if(next->statistics.waitStart)
 	{
-		entry = local->scheduling.list;
+		// Counters of different processors may be slightly apart
+		if(now > next->statistics.waitStart)
+			next->statistics.waitTime += now - next->statistics.waitStart;
+		next->statistics.waitStart = 0;
 	}
-	return entry;
 }
 
 void schedulerSetCurrent(g_tasking_local* local, g_task* task)
 {
 	mutexAcquire(&local->lock);
 	local->scheduling.current = task;
+	task->scheduling.sliceTime = 0;
+	uint32_t interval = _schedulerGetTimerInterval(local, task);
 	mutexRelease(&local->lock);
+
+	clockArmTimer(interval);
 }
 
-void schedulerPrefer(g_tid task)
+void schedulerPrefer(g_task* task)
 {
-	preferredTask = task;
+	if(!task)
+		return;
+
+	// Only a hint for this processor, validated when scheduling. Set with the lock held so
+	// that it is reliably cleared when the task is migrated or dies.
+	g_tasking_local* local = taskingGetLocal();
+	mutexAcquire(&local->lock);
+	if(task->assignment == local && task != local->scheduling.current)
+		local->scheduling.preferred = task;
+	mutexRelease(&local->lock);
 }
 
-void schedulerSchedule(g_tasking_local* local)
+void schedulerSchedule(g_tasking_local* local, bool timerTick)
 {
+	if(timerTick)
+		_schedulerBalance(local);
+
 	mutexAcquire(&local->lock);
+	local->scheduling.reschedulePending = false;
+
+	g_task* preferred = local->scheduling.preferred;
+	local->scheduling.preferred = nullptr;
 
-	if(!local->scheduling.current)
+	g_task* current = local->scheduling.current;
+	int currentLevel = -1;
+	if(current && current->scheduleEntry)
+		currentLevel = _schedulerGetRunnableLevel(local, current->scheduleEntry);
+
+	// Account the time that the current task ran since the last scheduling
+	uint64_t now = clockGetLocal()->time;
+	uint64_t elapsed = now - local->scheduling.lastScheduleTime;
+	local->scheduling.lastScheduleTime = now;
+	if(currentLevel != -1)
 	{
-		local->scheduling.current = local->scheduling.list->task;
-		mutexRelease(&local->lock);
-		return;
+		current->scheduling.sliceTime += elapsed;
+		current->scheduling.levelTime += elapsed;
 	}
 
-	g_schedule_entry* start = schedulerGetNextTask(local);
-	g_schedule_entry* entry = start;
-	for(;;)
+	if(timerTick)
 	{
-		g_task* task = entry->task;
+		_schedulerBoostDemoted(local);
 
-		bool done = false;
-
-		mutexAcquire(&task->lock);
-		if(task->status == G_TASK_STATUS_RUNNING)
+		if(currentLevel != -1 && current->status == G_TASK_STATUS_RUNNING)
 		{
-			local->scheduling.current = task;
-			local->scheduling.current->statistics.timesScheduled++;
-			done = true;
-		}
-		else
-		{
-			entry = entry->next;
-			if(!entry)
+			// Tasks that keep running without waiting are demoted
+			if(current->scheduling.levelTime >= G_SCHEDULER_DEMOTION_TIME &&
+			   currentLevel < _schedulerGetLowestLevel(current))
 			{
-				entry = local->scheduling.list;
+				_schedulerMoveToLevel(local, current->scheduleEntry, currentLevel + 1);
+				currentLevel = -1;
 			}
-
-			if(entry == start)
+			// Otherwise the task may continue until its slice is over
+			else if(current->scheduling.sliceTime < schedulerSliceTimes[currentLevel] &&
+			        !_schedulerHasHigherLevel(local, currentLevel))
 			{
-				local->scheduling.current = local->scheduling.idleTask;
-				local->scheduling.idleTask->statistics.timesScheduled++;
-				done = true;
+				uint32_t interval = _schedulerGetTimerInterval(local, current);
+				mutexRelease(&local->lock);
+
+				clockArmTimer(interval);
+				return;
 			}
 		}
-		mutexRelease(&task->lock);
+	}
+
+	// Rotate the current task to the back of its run queue or move it aside if it stopped running
+	if(currentLevel != -1)
+	{
+		mutexAcquire(&current->lock);
+		g_task_status status = current->status;
+		mutexRelease(&current->lock);
+
+		if(status == G_TASK_STATUS_RUNNING)
+		{
+			_schedulerQueueRemove(current->scheduleEntry);
+			_schedulerQueuePush(&local->scheduling.runnable[currentLevel], current->scheduleEntry);
+		}
+		else
+		{
+			_schedulerPark(local, current->scheduleEntry, status);
+		}
+	}
+
+	// A task that gives up the processor may hand the rest of its slice to another task
+	g_task* next = nullptr;
+	bool handoff = false;
+	if(!timerTick && preferred)
+	{
+		next = _schedulerTakePreferred(local, preferred);
+		handoff = next != nullptr;
+	}
+
+	if(!next)
+		next = _schedulerTakeNext(local);
+
+	// Instead of idling, steal work from a processor that has more than it is running
+	if(!next)
+	{
+		mutexRelease(&local->lock);
+		bool pulled = _schedulerPullFromBusiest(local, 2);
+		mutexAcquire(&local->lock);
 
-		if(done)
-			break;
+		if(pulled)
+			next = _schedulerTakeNext(local);
 	}
+
+	if(!next)
+		next = local->scheduling.idleTask;
+
+	next->scheduling.sliceTime = handoff && current ? current->scheduling.sliceTime : 0;
+	local->scheduling.current = next;
+	next->statistics.timesScheduled++;
+	_schedulerAccountWaiting(current, next);
+	uint32_t interval = _schedulerGetTimerInterval(local, next);
+	bool cleanup = local->scheduling.dead.head != nullptr;
 	mutexRelease(&local->lock);
 
+	if(cleanup && local->scheduling.cleanupTask)
+		taskingWake(local->scheduling.cleanupTask);
+
+	clockArmTimer(interval);
+
 #if G_DEBUG_THREAD_DUMPING
 	if(processorGetCurrentId() == 0 && (clockGetLocal()->time - clockGetLocal()->lastLogTime) > G_DEBUG_LOG_PAUSE)
 	{
@@ -169,40 +730,47 @@ void schedulerDump()
 		mutexAcquire(&local->lock);
 
 		logInfo("%# processor %i: time %i", i, (uint32_t) clock->time);
-		g_schedule_entry* entry = local->scheduling.list;
-		while(entry)
+		for(int level = 0; level <= G_SCHEDULER_LEVELS; level++)
 		{
-			auto task = entry->task;
-			const char* taskState;
-			if(task->status == G_TASK_STATUS_RUNNING)
-			{
-				taskState = "";
-			}
-			else if(task->status == G_TASK_STATUS_DEAD)
-			{
-				taskState = " [dead]";
-			}
-			else if(task->status == G_TASK_STATUS_WAITING)
-			{
-				taskState = " [waiting]";
-			}
-			else
-			{
-				taskState = "?";
-			}
+			g_schedule_queue* queue = level < G_SCHEDULER_LEVELS
+				                          ? &local->scheduling.runnable[level]
+				                          : &local->scheduling.blocked;
 
-			if(task->status != G_TASK_STATUS_DEAD)
+			g_schedule_entry* entry = queue->head;
+			while(entry)
 			{
-				auto identifier = taskingDirectoryGetIdentifier(task->id);
-				logInfo("%# - (%i:%i) usage: %i, %s %s %s", task->process->id, task->id,
-				        USAGE(task->statistics.timesScheduled, task->statistics.timesYielded),
-				        identifier == nullptr ? "" : identifier, taskState,
-				        task->status == G_TASK_STATUS_WAITING ? task->waitsFor : "");
-				task->statistics.timesScheduled = 0;
-				task->statistics.timesYielded = 0;
-			}
+				auto task = entry->task;
+				const char* taskState;
+				if(task->status == G_TASK_STATUS_RUNNING)
+				{
+					taskState = "";
+				}
+				else if(task->status == G_TASK_STATUS_DEAD)
+				{
+					taskState = " [dead]";
+				}
+				else if(task->status == G_TASK_STATUS_WAITING)
+				{
+					taskState = " [waiting]";
+				}
+				else
+				{
+					taskState = "?";
+				}
+
+				if(task->status != G_TASK_STATUS_DEAD)
+				{
+					auto identifier = taskingDirectoryGetIdentifier(task->id);
+					logInfo("%# - (%i:%i) level: %i, usage: %i, %s %s %s", task->process->id, task->id,
+					        task->scheduling.level, USAGE(task->statistics.timesScheduled, task->statistics.timesYielded),
+					        identifier == nullptr ? "" : identifier, taskState,
+					        task->status == G_TASK_STATUS_WAITING ? task->waitsFor : "");
+					task->statistics.timesScheduled = 0;
+					task->statistics.timesYielded = 0;
+				}
 
-			entry = entry->next;
+				entry = entry->next;
+			}
 		}
 
 		g_task* idle = local->scheduling.idleTask;
@@ -25,13 +25,17 @@
 #include "kernel/system/processor/processor_state.hpp"
 #include "kernel/utils/wait_queue.hpp"
 #include "kernel/system/mutex.hpp"
+#include "kernel/tasking/clock.hpp"
 
 #include <ghost/tasks/types.h>
 #include <ghost/system/types.h>
 
+#define G_TASK_PROCESSOR_NONE 0xFFFFFFFF
+
 struct g_process;
 struct g_task;
 struct g_tasking_local;
+struct g_schedule_entry;
 struct g_elf_object;
 
 /**
@@ -89,12 +93,67 @@ struct g_task
     g_tasking_local* assignment;
 
     /**
-     * Number of times this task was ever scheduled.
+     * Entry of this task in the scheduling queues of the processor it is assigned to.
+     */
+    g_schedule_entry* scheduleEntry;
+
+    /**
+     * Core that this task is bound to, or G_TASK_CORE_AFFINITY_NONE if the scheduler
+     * may move it to a different core to balance the load.
+     */
+    uint8_t coreAffinity;
+
+    /**
+     * Scheduling priority of this task. The level is the run queue that the task is
+     * currently in; a task that keeps running without waiting is demoted below the
+     * level of its priority and boosted back once it waits. Times are in milliseconds.
+     */
+    struct
+    {
+        g_task_priority priority;
+        int level;
+        uint64_t levelTime;
+        uint64_t sliceTime;
+    } scheduling;
+
+    /**
+     * Entry in the timer wheel while this task waits for a time.
+     */
+    g_clock_waiter clockWaiter;
+
+    /**
+     * Entry in the wait queue this task currently waits in.
+     */
+    g_wait_queue_entry waitQueueEntry;
+
+    /**
+     * Link in the waiters of the task mutex this task sleeps on. Granted is set
+     * when the mutex was handed over to this task.
+     */
+    struct
+    {
+        g_mutex* mutex;
+        g_task* next;
+        bool granted;
+    } mutexWait;
+
+    /**
+     * Number of times this task was ever scheduled and the time it spent running in user
+     * and kernel mode and waiting. Times are in timestamp counter ticks.
      */
     struct
     {
         int timesScheduled;
         int timesYielded;
+
+        uint64_t userTime;
+        uint64_t kernelTime;
+        uint64_t waitTime;
+
+        /**
+         * Timestamp of when the task stopped running to wait, or 0 if it is not waiting.
+         */
+        uint64_t waitStart;
     } statistics;
 
     /**
@@ -122,11 +181,20 @@ struct g_task
      */
     volatile g_processor_state* state;
 
+    /**
+     * FPU/SSE state of this task. The state buffer is only allocated once the task
+     * first uses the FPU and is only saved when another task wants to use it.
+     */
     struct
     {
         uint8_t* stateMem;
         uint8_t* state;
         bool stored;
+
+        /**
+         * Processor that the FPU registers were last loaded on.
+         */
+        uint32_t processor;
     } fpu;
 
     /**
@@ -179,6 +247,8 @@ struct g_task_entry
 #define G_PROC_VIRTUAL_RANGE_FLAG_NONE 0
 /* Weak flag signals that the physical memory mapped behind the virtual range is not managed by the kernel (for example MMIO). */
 #define G_PROC_VIRTUAL_RANGE_FLAG_WEAK 1
+/* Contiguous flag signals that the range is backed by a block of the contiguous allocator. */
+#define G_PROC_VIRTUAL_RANGE_FLAG_CONTIGUOUS 2
 
 struct g_process_spawn_arguments
 {
@@ -232,6 +302,16 @@ struct g_process
     g_physical_address pageSpace;
     g_address_range_pool* virtualRangePool;
 
+    /**
+     * Times of tasks of this process that have already been removed, in timestamp counter ticks.
+     */
+    struct
+    {
+        uint64_t userTime;
+        uint64_t kernelTime;
+        uint64_t waitTime;
+    } statistics;
+
     struct
     {
         g_virtual_address location;
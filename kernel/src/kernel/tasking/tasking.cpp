@@ -35,7 +35,9 @@
 #include "kernel/tasking/tasking_directory.hpp"
 #include "kernel/tasking/tasking_memory.hpp"
 #include "kernel/tasking/tasking_state.hpp"
+#include "kernel/memory/object_cache.hpp"
 #include "kernel/utils/hashmap.hpp"
+#include "kernel/utils/string.hpp"
 #include "kernel/utils/wait_queue.hpp"
 #include "kernel/logger/logger.hpp"
 #include "kernel/panic.hpp"
@@ -44,12 +46,16 @@ static g_tasking_local* taskingLocal = 0;
 static g_mutex taskingIdLock;
 static g_tid taskingIdNext = 0;
 
+static g_object_cache taskingTaskCache = G_OBJECT_CACHE_INITIALIZER("task", g_task);
+
 g_hashmap<g_tid, g_task*>* taskGlobalMap;
 
 void _taskingInitializeTask(g_task* task, g_process* process, g_security_level level);
 
 g_tasking_local* taskingGetLocal() { return &taskingLocal[processorGetCurrentId()]; }
 
+g_tasking_local* taskingGetLocalOf(uint32_t processor) { return &taskingLocal[processor]; }
+
 g_task* taskingGetCurrentTask()
 {
 	if(!systemIsReady())
@@ -128,8 +134,25 @@ void taskingInitializeLocal()
 	local->processor = processorGetCurrentId();
 
 	local->scheduling.current = nullptr;
-	local->scheduling.list = nullptr;
+	for(int level = 0; level < G_SCHEDULER_LEVELS; level++)
+		local->scheduling.runnable[level] = {};
+	local->scheduling.blocked = {};
+	local->scheduling.dead = {};
 	local->scheduling.idleTask = nullptr;
+	local->scheduling.cleanupTask = nullptr;
+	local->scheduling.interrupted = nullptr;
+	local->scheduling.preferred = nullptr;
+	local->scheduling.reschedulePending = false;
+	local->scheduling.longInterval = false;
+	local->scheduling.rearmPending = false;
+
+	local->fpu.owner = nullptr;
+	local->fpu.used = false;
+	local->lastAccountTime = processorReadTsc();
+	local->activeSpace = pagingGetCurrentSpace();
+	local->tlbFlushRequested = false;
+	if(processorHasFeatureReady(g_cpuid_standard_edx_feature::SSE))
+		processorEnableFpuTrap();
 
 	mutexInitializeGlobal(&local->lock, __func__);
 
@@ -154,6 +177,7 @@ void taskingCreateEssentialTasks()
 	g_process* cleanup = taskingCreateProcess(G_SECURITY_LEVEL_KERNEL);
 	g_task* cleanupTask = taskingCreateTask((g_virtual_address) taskingCleanupThread, cleanup, G_SECURITY_LEVEL_KERNEL);
 	cleanupTask->type = G_TASK_TYPE_VITAL;
+	local->scheduling.cleanupTask = cleanupTask;
 	taskingAssign(taskingGetLocal(), cleanupTask);
 	logInfo("%! core: %i cleanup task: %i", "tasking", processorGetCurrentId(), cleanup->main->id);
 }
@@ -181,6 +205,10 @@ void taskingProcessRemoveFromTaskList(g_task* task)
 {
 	mutexAcquire(&task->process->lock);
 
+	task->process->statistics.userTime += task->statistics.userTime;
+	task->process->statistics.kernelTime += task->statistics.kernelTime;
+	task->process->statistics.waitTime += task->statistics.waitTime;
+
 	g_task_entry* entry = task->process->tasks;
 	g_task_entry* previous = 0;
 	while(entry)
@@ -207,7 +235,7 @@ void taskingProcessRemoveFromTaskList(g_task* task)
 
 void taskingAssignBalanced(g_task* task)
 {
-	int lowestTaskCount = -1;
+	int lowestLoad = -1;
 	g_tasking_local* assignTo;
 
 	for(uint32_t core = 0; core < processorGetNumberOfProcessors(); core++)
@@ -215,18 +243,10 @@ void taskingAssignBalanced(g_task* task)
 		g_tasking_local* local = &taskingLocal[core];
 		mutexAcquire(&local->lock);
 
-		int taskCount = 0;
-		auto entry = local->scheduling.list;
-		while(entry)
-		{
-			if(entry->task->status != G_TASK_STATUS_DEAD)
-				++taskCount;
-			entry = entry->next;
-		}
-
-		if(lowestTaskCount == -1 || taskCount < lowestTaskCount)
+		int load = schedulerGetLoad(local);
+		if(lowestLoad == -1 || load < lowestLoad)
 		{
-			lowestTaskCount = taskCount;
+			lowestLoad = load;
 			assignTo = local;
 		}
 
@@ -240,6 +260,7 @@ void taskingAssignOnCore(uint8_t core, g_task* task)
 {
 	if(core < processorGetNumberOfProcessors())
 	{
+		task->coreAffinity = core;
 		taskingAssign(&taskingLocal[core], task);
 	}
 	else
@@ -252,25 +273,11 @@ void taskingAssign(g_tasking_local* local, g_task* task)
 {
 	mutexAcquire(&local->lock);
 
-	bool alreadyInList = false;
-	g_schedule_entry* existing = local->scheduling.list;
-	while(existing)
-	{
-		if(existing->task == task)
-		{
-			alreadyInList = true;
-			break;
-		}
-		existing = existing->next;
-	}
-
-	if(!alreadyInList)
+	if(!task->scheduleEntry)
 	{
-		g_schedule_entry* newEntry = (g_schedule_entry*) heapAllocate(sizeof(g_schedule_entry));
-		newEntry->task = task;
-		newEntry->next = local->scheduling.list;
-		schedulerPrepareEntry(newEntry);
-		local->scheduling.list = newEntry;
+		g_schedule_entry* newEntry = schedulerCreateEntry(task);
+		schedulerAddEntry(local, newEntry);
+		task->scheduleEntry = newEntry;
 	}
 
 	task->assignment = local;
@@ -279,19 +286,33 @@ void taskingAssign(g_tasking_local* local, g_task* task)
 	task->threadLocal.kernelThreadLocal->processor = local->processor;
 
 	mutexRelease(&local->lock);
+	schedulerArmPendingTimer();
 }
 
 void taskingSaveState(g_task* task, g_processor_state* state)
 {
 	// Save latest pointer to interrupt stack top
 	task->state = state;
+	taskingGetLocal()->scheduling.interrupted = task;
 
-	// Save FPU state
-	if(task->fpu.state)
-	{
-		processorSaveFpuState(task->fpu.state);
-		task->fpu.stored = true;
-	}
+	// Time until now was spent in the mode that was interrupted
+	taskingAccountTime(task, (state->cs & 3) == 3);
+}
+
+void taskingAccountTime(g_task* task, bool user)
+{
+	g_tasking_local* local = taskingGetLocal();
+	uint64_t now = processorReadTsc();
+	uint64_t elapsed = now - local->lastAccountTime;
+	local->lastAccountTime = now;
+
+	if(!task)
+		return;
+
+	if(user)
+		task->statistics.userTime += elapsed;
+	else
+		task->statistics.kernelTime += elapsed;
 }
 
 
@@ -301,14 +322,9 @@ void taskingRestoreState(g_task* task)
 		panic("%! tried to restore without a current task", "tasking");
 
 	// Switch to process address space
-	if(task->overridePageDirectory)
-	{
-		pagingSwitchToSpace(task->overridePageDirectory);
-	}
-	else
-	{
-		pagingSwitchToSpace(task->process->pageSpace);
-	}
+	g_physical_address space = task->overridePageDirectory ? task->overridePageDirectory : task->process->pageSpace;
+	taskingGetLocal()->activeSpace = space;
+	pagingSwitchToSpace(space);
 
 	// For TLS: write thread-local addresses
 	gdtSetTlsAddresses(task->threadLocal.userThreadLocal, task->threadLocal.kernelThreadLocal);
@@ -316,16 +332,43 @@ void taskingRestoreState(g_task* task)
 	// Set TSS RSP0 for ring 3 tasks to return onto
 	gdtSetTssRsp0(task->interruptStack.end);
 
-	// Restore FPU state
+	// Save FPU state of the previous task if it was used, trap on next use
+	g_tasking_local* local = taskingGetLocal();
+	if(local->fpu.used)
+	{
+		g_task* owner = local->fpu.owner;
+		processorSaveFpuState(owner->fpu.state);
+		owner->fpu.stored = true;
+		local->fpu.used = false;
+		processorEnableFpuTrap();
+	}
+}
+
+void taskingActivateFpu(g_task* task)
+{
+	g_tasking_local* local = taskingGetLocal();
+	processorDisableFpuTrap();
+	local->fpu.used = true;
+
+	// Registers still hold the state of this task
+	if(local->fpu.owner == task && task->fpu.processor == local->processor)
+		return;
+
+	if(!task->fpu.state)
+		taskingMemoryInitializeFpu(task);
+
 	if(task->fpu.stored)
 		processorRestoreFpuState(task->fpu.state);
+	else
+		processorRestoreFpuState((uint8_t*) processorGetInitialFpuState());
+
+	local->fpu.owner = task;
+	task->fpu.processor = local->processor;
 }
 
-void taskingSchedule(bool resetPreference)
+void taskingSchedule(bool timerTick)
 {
-	if(resetPreference && processorIsBsp())
-		schedulerPrefer(G_TID_NONE);
-	schedulerSchedule(taskingGetLocal());
+	schedulerSchedule(taskingGetLocal(), timerTick);
 }
 
 void taskingSetCurrent(g_task* task)
@@ -357,7 +400,7 @@ g_process* taskingCreateProcess(g_security_level securityLevel)
 
 void taskingDestroyProcess(g_process* process)
 {
-	if(process->object)
+	if(process->object && __sync_sub_and_fetch(&process->object->references, 1) == 0)
 		elfObjectDestroy(process->object);
 
 	filesystemProcessRemove(process->id);
@@ -375,7 +418,7 @@ void taskingDestroyProcess(g_process* process)
 
 g_task* taskingCreateTask(g_virtual_address eip, g_process* process, g_security_level level)
 {
-	auto task = (g_task*) heapAllocateClear(sizeof(g_task));
+	auto task = (g_task*) objectCacheAllocateClear(&taskingTaskCache);
 	if(!task)
 		return nullptr;
 
@@ -399,6 +442,101 @@ g_task* taskingCreateTask(g_virtual_address eip, g_process* process, g_security_
 	return task;
 }
 
+g_task* taskingFork(g_task* parent)
+{
+	g_process* parentProcess = parent->process;
+	g_process* process = taskingCreateProcess(parent->securityLevel);
+	if(!process)
+		return nullptr;
+
+	// Take over the process layout
+	addressRangePoolCloneRanges(process->virtualRangePool, parentProcess->virtualRangePool);
+
+	mutexAcquire(&parentProcess->lock);
+	process->tlsMaster.location = parentProcess->tlsMaster.location;
+	process->tlsMaster.size = parentProcess->tlsMaster.size;
+	process->tlsMaster.userThreadOffset = parentProcess->tlsMaster.userThreadOffset;
+	process->image.start = parentProcess->image.start;
+	process->image.end = parentProcess->image.end;
+	process->heap.brk = parentProcess->heap.brk;
+	process->heap.start = parentProcess->heap.start;
+	process->heap.pages = parentProcess->heap.pages;
+	process->userProcessInfo = parentProcess->userProcessInfo;
+
+	process->object = parentProcess->object;
+	if(process->object)
+		__sync_fetch_and_add(&process->object->references, 1);
+
+	if(parentProcess->environment.arguments)
+		process->environment.arguments = stringDuplicate(parentProcess->environment.arguments);
+	if(parentProcess->environment.executablePath)
+		process->environment.executablePath = stringDuplicate(parentProcess->environment.executablePath);
+	if(parentProcess->environment.workingDirectory)
+		process->environment.workingDirectory = stringDuplicate(parentProcess->environment.workingDirectory);
+
+	g_memory_file_ondemand** nextMapping = &process->onDemandMappings;
+	for(auto mapping = parentProcess->onDemandMappings; mapping; mapping = mapping->next)
+	{
+		auto copy = (g_memory_file_ondemand*) heapAllocate(sizeof(g_memory_file_ondemand));
+		*copy = *mapping;
+		copy->next = nullptr;
+		*nextMapping = copy;
+		nextMapping = &copy->next;
+	}
+	mutexRelease(&parentProcess->lock);
+
+	taskingMemoryForkPageSpace(parentProcess, process);
+
+	// Writable entries of the parent became read-only
+	interruptsSendTlbFlush();
+
+	// Create the main task, continuing where the parent currently is
+	auto task = (g_task*) objectCacheAllocateClear(&taskingTaskCache);
+
+	_taskingInitializeTask(task, process, parent->securityLevel);
+	task->type = G_TASK_TYPE_DEFAULT;
+	task->stack = parent->stack;
+	task->threadLocal.userThreadLocal = parent->threadLocal.userThreadLocal;
+	task->threadLocal.start = parent->threadLocal.start;
+	task->threadLocal.end = parent->threadLocal.end;
+	task->userEntry.function = parent->userEntry.function;
+	task->userEntry.data = parent->userEntry.data;
+
+	taskingMemoryInitializeUtility(task);
+	task->interruptStack = taskingMemoryCreateStack(memoryVirtualRangePool, G_PAGE_TABLE_KERNEL_DEFAULT,
+	                                                G_PAGE_KERNEL_DEFAULT, G_TASKING_MEMORY_INTERRUPT_STACK_PAGES);
+	taskingMemoryInitializeTls(task);
+
+	// The user state of the parent is always on top of its interrupt stack
+	task->state = (g_processor_state*) (task->interruptStack.end - sizeof(g_processor_state));
+	memoryCopy((void*) task->state, (void*) (parent->interruptStack.end - sizeof(g_processor_state)),
+	           sizeof(g_processor_state));
+
+	INTERRUPTS_PAUSE;
+	g_tasking_local* local = taskingGetLocal();
+	if(local->fpu.used && local->fpu.owner == parent)
+	{
+		taskingMemoryInitializeFpu(task);
+		processorSaveFpuState(task->fpu.state);
+		task->fpu.stored = true;
+	}
+	else if(parent->fpu.stored)
+	{
+		taskingMemoryInitializeFpu(task);
+		memoryCopy(task->fpu.state, parent->fpu.state, G_SSE_STATE_SIZE);
+		task->fpu.stored = true;
+	}
+	INTERRUPTS_RESUME;
+
+	taskingProcessAddToTaskList(process, task);
+	hashmapPut(taskGlobalMap, task->id, task);
+
+	filesystemProcessCloneAll(parentProcess->id, process->id);
+
+	logDebug("%! forked process %i from task %i", "tasking", process->id, parent->id);
+	return task;
+}
+
 g_task* taskingCreateTaskVm86(g_process* process, uint32_t intr, g_vm86_registers in, g_vm86_registers* out)
 {
 	panic("no vm86");
@@ -406,13 +544,17 @@ g_task* taskingCreateTaskVm86(g_process* process, uint32_t intr, g_vm86_register
 
 void taskingDestroyTask(g_task* task)
 {
+	clockUnwaitForTime(task);
+	waitQueueDetach(task);
+	mutexDetachWaiter(task);
+
 	mutexAcquire(&task->lock);
 
 	if(task->status != G_TASK_STATUS_DEAD)
 		panic("%! tried to remove a task %i that is not dead", "tasking", task->id);
 
 	// Wake up tasks that joined this task
-	waitQueueWake(&task->waitersJoin);
+	waitQueueDestroy(&task->waitersJoin);
 
 	// Switch to task space
 	g_physical_address returnDirectory = taskingMemoryTemporarySwitchTo(task->process->pageSpace);
@@ -437,7 +579,7 @@ void taskingDestroyTask(g_task* task)
 		heapFree(task->vm86Data);
 
 	mutexRelease(&task->lock);
-	heapFree(task);
+	objectCacheFree(&taskingTaskCache, task);
 }
 
 void _taskingInitializeTask(g_task* task, g_process* process, g_security_level level)
@@ -449,6 +591,10 @@ void _taskingInitializeTask(g_task* task, g_process* process, g_security_level l
 	task->process = process;
 	task->securityLevel = level;
 	task->status = G_TASK_STATUS_RUNNING;
+	task->coreAffinity = G_TASK_CORE_AFFINITY_NONE;
+	task->clockWaiter.task = task;
+	task->waitQueueEntry.task = task;
+	schedulerSetPriority(task, schedulerGetDefaultPriority(task));
 	waitQueueInitialize(&task->waitersJoin);
 	mutexInitializeGlobal(&task->lock, __func__);
 }
@@ -468,6 +614,7 @@ void taskingProcessKillAllTasks(g_pid pid)
 	while(entry)
 	{
 		entry->task->status = G_TASK_STATUS_DEAD;
+		schedulerNotifyDead(entry->task);
 		entry = entry->next;
 	}
 
@@ -558,6 +705,7 @@ void taskingFinalizeSpawn(g_task* task)
 	auto process = task->process;
 	task->securityLevel = process->spawnArgs->securityLevel;
 	taskingStateReset(task, process->spawnArgs->entry, task->securityLevel);
+	schedulerSetPriority(task, schedulerGetDefaultPriority(task));
 
 	taskingWait(task, __func__, [task, process]()
 	{
@@ -567,15 +715,24 @@ void taskingFinalizeSpawn(g_task* task)
 	});
 }
 
-void taskingWaitForExit(g_tid joinedTid, g_tid waiter)
+void taskingWaitForExit(g_tid joinedTid, g_task* waiter)
 {
 	g_task* task = taskingGetById(joinedTid);
 	if(!task)
+	{
+		taskingWake(waiter);
 		return;
+	}
 
-	mutexAcquire(&task->process->lock);
-	waitQueueAdd(&task->waitersJoin, waiter);
-	mutexRelease(&task->process->lock);
+	// Joiners are woken under the task lock once it is dead
+	mutexAcquire(&task->lock);
+	bool dead = task->status == G_TASK_STATUS_DEAD;
+	if(!dead)
+		waitQueueAdd(&task->waitersJoin, waiter);
+	mutexRelease(&task->lock);
+
+	if(dead)
+		taskingWake(waiter);
 }
 
 void taskingWake(g_task* task)
@@ -583,9 +740,13 @@ void taskingWake(g_task* task)
 	if(task)
 	{
 		mutexAcquire(&task->lock);
-		if(task->status == G_TASK_STATUS_WAITING)
+		bool woken = task->status == G_TASK_STATUS_WAITING;
+		if(woken)
 			task->status = G_TASK_STATUS_RUNNING;
 		mutexRelease(&task->lock);
+
+		if(woken)
+			schedulerNotifyRunnable(task);
 	}
 }
 
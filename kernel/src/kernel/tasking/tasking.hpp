@@ -30,10 +30,34 @@
 
 extern g_hashmap<g_tid, g_task*>* taskGlobalMap;
 
+/**
+ * Number of priority levels that the scheduler keeps a run queue for.
+ */
+#define G_SCHEDULER_LEVELS 4
+
+struct g_schedule_queue;
+
 struct g_schedule_entry
 {
     g_task* task;
     g_schedule_entry* next;
+    g_schedule_entry* previous;
+
+    /**
+     * Queue that this entry is currently linked into.
+     */
+    g_schedule_queue* queue;
+};
+
+/**
+ * Doubly-linked queue of schedule entries, allows constant-time insertion at
+ * the tail and removal of any entry.
+ */
+struct g_schedule_queue
+{
+    g_schedule_entry* head;
+    g_schedule_entry* tail;
+    int count;
 };
 
 /**
@@ -66,11 +90,113 @@ struct g_tasking_local
      */
     struct
     {
-        g_schedule_entry* list;
+        /**
+         * Tasks that are ready to run in round-robin order, one queue per priority
+         * level. Tasks that stopped running are moved out of these queues lazily
+         * when the scheduler sees them.
+         */
+        g_schedule_queue runnable[G_SCHEDULER_LEVELS];
+
+        /**
+         * Tasks that are waiting. Waking a task moves it back into the run queue.
+         */
+        g_schedule_queue blocked;
+
+        /**
+         * Tasks that have died and are no longer running. The cleanup task is woken
+         * to destroy them.
+         */
+        g_schedule_queue dead;
+
         g_task* current;
 
         g_task* idleTask;
+
+        g_task* cleanupTask;
+
+        /**
+         * Task that the current task has handed the processor to. When the current
+         * task gives up the processor, this task runs next on the rest of its time
+         * slice. Reset on each scheduling and when the task is migrated or dies;
+         * only accessed with the local lock held.
+         */
+        g_task* preferred;
+
+        /**
+         * Set when another processor has requested this processor to schedule,
+         * so that only one request is sent until it did.
+         */
+        bool reschedulePending;
+
+        /**
+         * Set when the timer was armed for the longest interval because no other task
+         * was runnable. Once there is, the slice timer has to be armed again.
+         */
+        bool longInterval;
+
+        /**
+         * Set when the timer of this processor has to be armed for the next slice check
+         * once the local lock is released. Requests from the processor itself can't
+         * use an interrupt.
+         */
+        bool rearmPending;
+
+        /**
+         * Task that was running when this processor was last interrupted. The interrupt
+         * handler operates on its stack and thread-local storage until it returns, so
+         * this task must not be moved to a different processor before the next interrupt.
+         */
+        g_task* volatile interrupted;
+
+        /**
+         * Time when demoted tasks were last moved back to the level of their priority.
+         */
+        uint64_t lastBoostTime;
+
+        /**
+         * Time when the load of this processor was last compared to the others.
+         */
+        uint64_t lastBalanceTime;
+
+        /**
+         * Time when the running task was last accounted for.
+         */
+        uint64_t lastScheduleTime;
     } scheduling;
+
+    /**
+     * Lazy FPU switching. The FPU registers are not touched on a task switch, instead
+     * the first FPU instruction of a task traps and only then the state is exchanged.
+     */
+    struct
+    {
+        /**
+         * Task whose state is currently loaded in the FPU registers.
+         */
+        g_task* owner;
+
+        /**
+         * Whether the FPU was used since the last task switch, so the registers
+         * have to be saved to the owner.
+         */
+        bool used;
+    } fpu;
+
+    /**
+     * Timestamp counter value when processor time was last accounted to a task.
+     */
+    uint64_t lastAccountTime;
+
+    /**
+     * Address space that is currently loaded on this processor. TLB shootdowns for
+     * a space only have to reach the processors that have it loaded.
+     */
+    volatile g_physical_address activeSpace;
+
+    /**
+     * Set by another processor that waits for this one to flush its TLB.
+     */
+    volatile bool tlbFlushRequested;
 };
 
 struct g_spawn_result
@@ -85,6 +211,11 @@ struct g_spawn_result
  */
 g_tasking_local* taskingGetLocal();
 
+/**
+ * @return the tasking structure of the given processor
+ */
+g_tasking_local* taskingGetLocalOf(uint32_t processor);
+
 /**
  * @return the task that is on this processor currently running or was
  * last running when called from within a system call handler
@@ -122,12 +253,13 @@ void taskingCreateEssentialTasks();
 void taskingAssign(g_tasking_local* local, g_task* task);
 
 /**
- * Assign a task to any core with the least load.
+ * Assign a task to any core with the least load. Tasks without core affinity may
+ * later be moved to other cores by the scheduler.
  */
 void taskingAssignBalanced(g_task* task);
 
 /**
- * Assigns a task to a specific core.
+ * Assigns a task to a specific core and binds it to that core.
  */
 void taskingAssignOnCore(uint8_t core, g_task* task);
 
@@ -156,6 +288,17 @@ g_process* taskingCreateProcess(g_security_level securityLevel);
  */
 g_task* taskingCreateTask(g_virtual_address entry, g_process* process, g_security_level level);
 
+/**
+ * Forks the process of the given user task. The new process gets a copy-on-write view
+ * of the parent address space and clones of its file descriptors, its main thread
+ * continues with the user state of the parent task. The task is not yet assigned.
+ *
+ * @param parent
+ * 		task that performs the fork, must currently be in a system call
+ * @return the main task of the new process or null
+ */
+g_task* taskingFork(g_task* parent);
+
 /**
  * Creates a special kind of task that performs a virtual 8086 call.
  */
@@ -188,8 +331,12 @@ void taskingProcessRemoveFromTaskList(g_task* task);
 
 /**
  * Schedules and sets the next task as the current. May only be called during interrupt handling!
+ *
+ * @param timerTick
+ * 		whether this was caused by the timer; the current task then only
+ * 		switches once its time slice is used up
  */
-void taskingSchedule(bool resetPreference = false);
+void taskingSchedule(bool timerTick = false);
 
 /**
  * Immediately sets a given task as the next one to execute. Dangerous because this only
@@ -199,16 +346,30 @@ void taskingSetCurrent(g_task* task);
 
 /**
  * Saves the state pointer that points to the stored state on the tasks kernel
- * stack. Also stores additional registers like for SSE.
+ * stack and remembers the task as the one that was interrupted on this processor.
  */
 void taskingSaveState(g_task* task, g_processor_state* state);
 
 /**
  * Applies the context switch to the task which is the current one for this core. This sets
- * the correct page directory and TLS variables.
+ * the correct page directory and TLS variables. If the FPU was used by the previous task,
+ * its state is saved and the FPU is trapped again.
  */
 void taskingRestoreState(g_task* task);
 
+/**
+ * Accounts the processor time since the last accounting on this processor to the task,
+ * either as time spent in user or in kernel mode. The task may be null, in which case
+ * the time is not accounted to anyone.
+ */
+void taskingAccountTime(g_task* task, bool user);
+
+/**
+ * Called when the task used the FPU while it was trapped. Loads the state of the
+ * task into the FPU unless it is still there and allows using it until the next switch.
+ */
+void taskingActivateFpu(g_task* task);
+
 /**
  * Yields control to the next task. This can only be called while no mutexes
  * are currently acquired by this thread, otherwise the kernel could get deadlocked.
@@ -251,7 +412,7 @@ void taskingFinalizeSpawn(g_task* task);
 /**
  * Waits until the task exits and then wakes the waiting task.
  */
-void taskingWaitForExit(g_tid task, g_tid waiter);
+void taskingWaitForExit(g_tid task, g_task* waiter);
 
 /**
  * Wakes the task.
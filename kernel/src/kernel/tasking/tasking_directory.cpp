@@ -48,7 +48,7 @@ g_task_directory_entry* _taskingDirectoryGetOrCreateEntry(const char* name)
 	return entry;
 }
 
-void taskingDirectoryWaitForRegister(const char* name, g_tid task)
+void taskingDirectoryWaitForRegister(const char* name, g_task* task)
 {
 	mutexAcquire(&entryLock);
 
@@ -58,7 +58,7 @@ void taskingDirectoryWaitForRegister(const char* name, g_tid task)
 	mutexRelease(&entryLock);
 }
 
-void taskingDirectoryUnwaitForRegister(const char* name, g_tid task)
+void taskingDirectoryUnwaitForRegister(const char* name, g_task* task)
 {
 	mutexAcquire(&entryLock);
 
@@ -55,7 +55,7 @@ const char* taskingDirectoryGetIdentifier(g_tid tid);
 /**
  * Adds the task to the wait queue for when another task registers with this identifier.
  */
-void taskingDirectoryWaitForRegister(const char* name, g_tid task);
-void taskingDirectoryUnwaitForRegister(const char* name, g_tid task);
+void taskingDirectoryWaitForRegister(const char* name, g_task* task);
+void taskingDirectoryUnwaitForRegister(const char* name, g_task* task);
 
 #endif
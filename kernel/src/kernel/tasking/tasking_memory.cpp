@@ -100,28 +100,17 @@ void taskingMemoryInitialize(g_task* task)
 
 void taskingMemoryInitializeUtility(g_task* task)
 {
-	if(processorHasFeature(g_cpuid_standard_edx_feature::SSE))
-	{
-		// TODO Allocator not capable of aligned allocation
-		task->fpu.stateMem = (uint8_t*) heapAllocate(G_SSE_STATE_SIZE + G_SSE_STATE_ALIGNMENT);
-		task->fpu.state = (uint8_t*) G_ALIGN_UP((g_address) task->fpu.stateMem, G_SSE_STATE_ALIGNMENT);
-
-		if(task->process && task->process->main && task->process->main != task)
-		{
-			memoryCopy(task->fpu.state, task->process->main->fpu.state, G_SSE_STATE_SIZE);
-			task->fpu.stored = true;
-		}
-		else
-		{
-			memoryCopy(task->fpu.state, processorGetInitialFpuState(), G_SSE_STATE_SIZE);
-		}
-	}
-	else
-	{
-		task->fpu.stateMem = nullptr;
-		task->fpu.state = nullptr;
-	}
+	task->fpu.stateMem = nullptr;
+	task->fpu.state = nullptr;
 	task->fpu.stored = false;
+	task->fpu.processor = G_TASK_PROCESSOR_NONE;
+}
+
+void taskingMemoryInitializeFpu(g_task* task)
+{
+	// TODO Allocator not capable of aligned allocation
+	task->fpu.stateMem = (uint8_t*) heapAllocate(G_SSE_STATE_SIZE + G_SSE_STATE_ALIGNMENT);
+	task->fpu.state = (uint8_t*) G_ALIGN_UP((g_address) task->fpu.stateMem, G_SSE_STATE_ALIGNMENT);
 }
 
 void taskingMemoryInitializeStacks(g_task* task)
@@ -288,6 +277,101 @@ void taskingMemoryDestroyPageSpace(g_physical_address directory)
 	memoryPhysicalFree(directory);
 }
 
+/**
+ * Allocates a zeroed paging structure for a forked space.
+ */
+static g_address* _taskingMemoryForkCreateTable(g_address* parentEntry, g_address* childEntry)
+{
+	g_physical_address tablePhys = bitmapPageAllocatorAllocate(&memoryPhysicalAllocator);
+	auto table = (g_address*) G_MEM_PHYS_TO_VIRT(tablePhys);
+	for(int i = 0; i < 512; i++)
+		table[i] = 0;
+
+	*childEntry = tablePhys | (*parentEntry & G_PAGE_ALIGN_MASK);
+	return table;
+}
+
+/**
+ * Creates the child entry for a page of the parent.
+ */
+static void _taskingMemoryForkPage(g_address* parentEntry, g_address* childEntry)
+{
+	g_address entry = *parentEntry;
+	g_physical_address phys = entry & ~G_PAGE_ALIGN_MASK;
+
+	if(!(entry & G_PAGE_USER_FLAG) || (entry & G_PAGE_SHARED_FLAG))
+	{
+		// Kernel-owned or shared memory is mapped as it is
+		*childEntry = entry;
+		if(entry & G_PAGE_SHARED_FLAG)
+			pageReferenceTrackerIncrement(phys);
+	}
+	else if(!pageReferenceTrackerIsTracked(phys))
+	{
+		// References can't be counted, so the page must be copied right away
+		g_physical_address copy = memoryPhysicalAllocate();
+		memoryCopy((void*) G_MEM_PHYS_TO_VIRT(copy), (void*) G_MEM_PHYS_TO_VIRT(phys), G_PAGE_SIZE);
+		*childEntry = copy | (entry & G_PAGE_ALIGN_MASK);
+	}
+	else
+	{
+		if(entry & G_PAGE_WRITABLE_FLAG)
+		{
+			entry = (entry & ~G_PAGE_WRITABLE_FLAG) | G_PAGE_COPY_ON_WRITE_FLAG;
+			*parentEntry = entry;
+		}
+		*childEntry = entry;
+		pageReferenceTrackerIncrement(phys);
+	}
+}
+
+void taskingMemoryForkPageSpace(g_process* parent, g_process* child)
+{
+	mutexAcquire(&memoryCopyOnWriteLock);
+
+	auto parentPml4 = (g_address*) G_MEM_PHYS_TO_VIRT(parent->pageSpace);
+	auto childPml4 = (g_address*) G_MEM_PHYS_TO_VIRT(child->pageSpace);
+
+	for(size_t pml4i = 0; pml4i < 256; pml4i++)
+	{
+		if(!parentPml4[pml4i])
+			continue;
+
+		auto parentPdpt = (g_address*) G_MEM_PHYS_TO_VIRT(parentPml4[pml4i] & ~G_PAGE_ALIGN_MASK);
+		auto childPdpt = _taskingMemoryForkCreateTable(&parentPml4[pml4i], &childPml4[pml4i]);
+
+		for(size_t pdpti = 0; pdpti < 512; pdpti++)
+		{
+			if(!parentPdpt[pdpti])
+				continue;
+
+			auto parentPd = (g_address*) G_MEM_PHYS_TO_VIRT(parentPdpt[pdpti] & ~G_PAGE_ALIGN_MASK);
+			auto childPd = _taskingMemoryForkCreateTable(&parentPdpt[pdpti], &childPdpt[pdpti]);
+
+			for(size_t pdi = 0; pdi < 512; pdi++)
+			{
+				if(!parentPd[pdi])
+					continue;
+
+				// Large pages are split so that each page can become copy-on-write on its own
+				if(parentPd[pdi] & G_PAGE_LARGE_PAGE_FLAG)
+					pagingSplitLargePageEntry(&parentPd[pdi]);
+
+				auto parentPt = (g_address*) G_MEM_PHYS_TO_VIRT(parentPd[pdi] & ~G_PAGE_ALIGN_MASK);
+				auto childPt = _taskingMemoryForkCreateTable(&parentPd[pdi], &childPd[pdi]);
+
+				for(size_t pti = 0; pti < 512; pti++)
+				{
+					if(parentPt[pti] & G_PAGE_PRESENT)
+						_taskingMemoryForkPage(&parentPt[pti], &childPt[pti]);
+				}
+			}
+		}
+	}
+
+	mutexRelease(&memoryCopyOnWriteLock);
+}
+
 void taskingMemoryInitializeTls(g_task* task)
 {
 	// Kernel thread-local storage
@@ -365,6 +449,7 @@ g_physical_address taskingMemoryTemporarySwitchTo(g_physical_address pageDirecto
 
 		local->scheduling.current->overridePageDirectory = pageDirectory;
 	}
+	local->activeSpace = pageDirectory;
 	pagingSwitchToSpace(pageDirectory);
 	return back;
 }
@@ -374,6 +459,7 @@ void taskingMemoryTemporarySwitchBack(g_physical_address back)
 	g_tasking_local* local = taskingGetLocal();
 	if(local->scheduling.current)
 		local->scheduling.current->overridePageDirectory = 0;
+	local->activeSpace = back;
 	pagingSwitchToSpace(back);
 }
 
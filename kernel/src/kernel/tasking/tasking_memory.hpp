@@ -43,6 +43,12 @@ void taskingMemoryInitialize(g_task* task);
  */
 void taskingMemoryInitializeUtility(g_task* task);
 
+/**
+ * Allocates the storage for FPU registers of the task. This is done on
+ * the first use of the FPU.
+ */
+void taskingMemoryInitializeFpu(g_task* task);
+
 /**
  * Creates the stacks for a newly created task.
  *
@@ -93,6 +99,13 @@ g_physical_address taskingMemoryCreatePageSpace();
  */
 void taskingMemoryDestroyPageSpace(g_physical_address directory);
 
+/**
+ * Fills the (freshly created) page space of the child with the lower-half mappings
+ * of the parent. Writable user pages are marked copy-on-write in both spaces, pages
+ * flagged as shared stay shared. The caller must flush the TLBs afterwards.
+ */
+void taskingMemoryForkPageSpace(g_process* parent, g_process* child);
+
 /**
  * Initializes the tasks thread-local-storage. Creates a copy of the master TLS for this task.
  */
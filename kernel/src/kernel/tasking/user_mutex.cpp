@@ -20,202 +20,129 @@
 
 #include "kernel/tasking/user_mutex.hpp"
 #include "kernel/memory/heap.hpp"
+#include "kernel/memory/paging.hpp"
+#include "kernel/memory/constants.hpp"
 #include "kernel/utils/hashmap.hpp"
-#include "kernel/system/interrupts/interrupts.hpp"
 #include "kernel/tasking/clock.hpp"
 #include "kernel/logger/logger.hpp"
 
-static g_user_mutex nextMutex;
-static g_mutex globalLock;
-static g_hashmap<g_user_mutex, g_user_mutex_entry*>* mutexMap;
+static g_hashmap<g_physical_address, g_user_mutex_entry*>* mutexMap;
 
-void _userMutexSetTaskWaiting(g_user_mutex_entry* entry, g_task* task);
-void _userMutexWakeWaitingTasks(g_user_mutex_entry* entry);
+g_physical_address _userMutexKey(volatile int32_t* word);
+g_user_mutex_entry* _userMutexRetain(g_physical_address key, bool create);
+void _userMutexRelease(g_physical_address key, g_user_mutex_entry* entry);
 
 void userMutexInitialize()
 {
-	mutexInitializeGlobal(&globalLock, __func__);
-	nextMutex = 0;
-	mutexMap = hashmapCreateNumeric<g_user_mutex, g_user_mutex_entry*>(128);
+	mutexMap = hashmapCreateNumeric<g_physical_address, g_user_mutex_entry*>(128);
 }
 
-g_user_mutex userMutexCreate(bool reentrant)
+g_user_mutex_wait_status userMutexWait(g_task* task, volatile int32_t* word, int32_t expected, uint64_t timeout)
 {
-	g_user_mutex_entry* entry = (g_user_mutex_entry*) heapAllocate(sizeof(g_user_mutex_entry));
-	mutexInitializeTask(&entry->lock, __func__);
-	entry->value = 0;
-	waitQueueInitialize(&entry->waiters);
-	entry->reentrant = reentrant;
-	entry->owner = -1;
-
-	mutexAcquire(&globalLock);
-	g_user_mutex mutex = ++nextMutex;
-	mutexRelease(&globalLock);
-	hashmapPut(mutexMap, mutex, entry);
-
-	return mutex;
-}
-
-g_user_mutex_status userMutexTryAcquire(g_task* task, g_user_mutex mutex)
-{
-	g_user_mutex_entry* entry = hashmapGet<g_user_mutex, g_user_mutex_entry*>(mutexMap, mutex, nullptr);
-	if(!entry)
+	g_physical_address key = _userMutexKey(word);
+	if(!key)
 	{
-		logWarn("%! task %i tried to lock unknown mutex %i", "mutex", task->id, mutex);
-		return false;
+		logWarn("%! task %i tried to wait on invalid word %x", "mutex", task->id, word);
+		return G_USER_MUTEX_WAIT_STATUS_INVALID;
 	}
 
-	g_user_mutex_status status;
-	mutexAcquire(&entry->lock);
-	if(entry->value)
-	{
-		if(entry->reentrant && task->id == entry->owner)
-		{
-			entry->value++;
-			status = G_USER_MUTEX_STATUS_ACQUIRED;
-		}
-		else
-			status = G_USER_MUTEX_STATUS_NOT_ACQUIRED;
-	}
-	else
-	{
-		status = G_USER_MUTEX_STATUS_ACQUIRED;
-		entry->value = 1;
-		if(entry->reentrant)
-		{
-			entry->owner = task->id;
-		}
-		else
-			entry->owner = G_TID_NONE;
-	}
-	mutexRelease(&entry->lock);
-	return status;
-}
-
-g_user_mutex_status userMutexAcquire(g_task* task, g_user_mutex mutex, uint64_t timeout, bool trying)
-{
-	g_user_mutex_entry* entry = hashmapGet<g_user_mutex, g_user_mutex_entry*>(mutexMap, mutex, nullptr);
-	if(!entry)
-	{
-		logWarn("%! task %i attempted to acquire unknown mutex %i", "mutex", taskingGetCurrentTask()->id, mutex);
-		return G_USER_MUTEX_STATUS_NOT_ACQUIRED;
-	}
-
-	bool wasSet = false;
-	bool hasTimeout = false;
+	g_user_mutex_entry* entry = _userMutexRetain(key, true);
 
 	bool useTimeout = (timeout > 0);
 	if(useTimeout)
-		clockWaitForTime(task->id, clockGetLocal()->time + timeout);
+		clockWaitForTime(task, clockGetTime() + timeout);
 
-	while(true)
+	// Checking the word under the entry lock makes sure that a waker that changed it
+	// either sees us in the queue or we see its change
+	g_user_mutex_wait_status status;
+	mutexAcquire(&entry->lock);
+	if(*word != expected)
 	{
-		mutexAcquire(&entry->lock);
-		bool stop = false;
-		if(useTimeout && (hasTimeout = clockHasTimedOut(task->id)))
-		{
-			stop = true;
-		}
-		else
-		{
-			g_user_mutex_status status = userMutexTryAcquire(task, mutex);
-			wasSet = (status == G_USER_MUTEX_STATUS_ACQUIRED);
-			stop = wasSet || trying;
-		}
-		if(stop)
-		{
-			mutexRelease(&entry->lock);
-			break;
-		}
-
-		taskingWait(task, __func__, [mutex, entry, task]()
+		status = G_USER_MUTEX_WAIT_STATUS_CHANGED;
+		mutexRelease(&entry->lock);
+	}
+	else
+	{
+		taskingWait(task, __func__, [entry, task]()
 		{
-			userMutexWaitForAcquire(mutex, task->id);
+			waitQueueAdd(&entry->waiters, task);
 			mutexRelease(&entry->lock);
 		});
+		waitQueueRemove(&entry->waiters, task);
+
+		status = (useTimeout && clockHasTimedOut(task))
+			         ? G_USER_MUTEX_WAIT_STATUS_TIMEOUT
+			         : G_USER_MUTEX_WAIT_STATUS_WOKEN;
 	}
 
 	if(useTimeout)
-		clockUnwaitForTime(task->id);
+		clockUnwaitForTime(task);
 
-	userMutexUnwaitForAcquire(mutex, task->id);
-
-	return hasTimeout
-		       ? G_USER_MUTEX_STATUS_TIMEOUT
-		       : (wasSet ? G_USER_MUTEX_STATUS_ACQUIRED : G_USER_MUTEX_STATUS_NOT_ACQUIRED);
+	_userMutexRelease(key, entry);
+	return status;
 }
 
-void userMutexRelease(g_user_mutex mutex)
+uint32_t userMutexWake(g_task* task, volatile int32_t* word, uint32_t count)
 {
-	g_user_mutex_entry* entry = hashmapGet<g_user_mutex, g_user_mutex_entry*>(mutexMap, mutex, nullptr);
-	if(!entry)
+	g_physical_address key = _userMutexKey(word);
+	if(!key)
 	{
-		logWarn("%! task %i tried to unlock unknown mutex %i", "mutex", taskingGetCurrentTask()->id, mutex);
-		return;
+		logWarn("%! task %i tried to wake invalid word %x", "mutex", task->id, word);
+		return 0;
 	}
 
+	g_user_mutex_entry* entry = _userMutexRetain(key, false);
+	if(!entry)
+		return 0;
+
+	uint32_t woken = 0;
 	mutexAcquire(&entry->lock);
-	if(entry->reentrant)
-	{
-		entry->value--;
-		if(entry->value <= 0)
-		{
-			if(entry->value < 0)
-			{
-				logInfo("over-release of mutex %x", entry);
-			}
-			entry->value = 0;
-			entry->owner = G_TID_NONE;
-			_userMutexWakeWaitingTasks(entry);
-		}
-	}
-	else
-	{
-		entry->value = 0;
-		_userMutexWakeWaitingTasks(entry);
-	}
+	while(woken < count && waitQueueWakeOne(&entry->waiters))
+		woken++;
 	mutexRelease(&entry->lock);
+
+	_userMutexRelease(key, entry);
+	return woken;
 }
 
-void userMutexDestroy(g_user_mutex mutex)
+g_physical_address _userMutexKey(volatile int32_t* word)
 {
-	userMutexRelease(mutex);
-
-	mutexAcquire(&mutexMap->lock);
-	g_user_mutex_entry* entry = hashmapGet<g_user_mutex, g_user_mutex_entry*>(mutexMap, mutex, nullptr);
-	if(entry)
-	{
-		hashmapRemove(mutexMap, mutex);
-		heapFree(entry);
-	}
-	mutexRelease(&mutexMap->lock);
+	auto address = (g_virtual_address) word;
+	if(address == 0 || address >= G_KERNEL_AREA_START || (address & (sizeof(int32_t) - 1)))
+		return 0;
+
+	g_physical_address page = pagingVirtualToPhysical(G_PAGE_ALIGN_DOWN(address));
+	if(!page)
+		return 0;
+	return page + (address & G_PAGE_ALIGN_MASK);
 }
 
-void userMutexWaitForAcquire(g_user_mutex mutex, g_tid task)
+g_user_mutex_entry* _userMutexRetain(g_physical_address key, bool create)
 {
-	g_user_mutex_entry* entry = hashmapGet<g_user_mutex, g_user_mutex_entry*>(mutexMap, mutex, nullptr);
-	if(!entry)
+	rwlockAcquireWrite(&mutexMap->lock);
+	g_user_mutex_entry* entry = hashmapGet<g_physical_address, g_user_mutex_entry*>(mutexMap, key, nullptr);
+	if(!entry && create)
 	{
-		logWarn("%! tried to add waiter for task %i to unknown mutex %i", "mutex", task, mutex);
-		return;
+		entry = (g_user_mutex_entry*) heapAllocate(sizeof(g_user_mutex_entry));
+		mutexInitializeTask(&entry->lock, __func__);
+		entry->references = 0;
+		waitQueueInitialize(&entry->waiters);
+		hashmapPut(mutexMap, key, entry);
 	}
-
-	waitQueueAdd(&entry->waiters, task);
+	if(entry)
+		entry->references++;
+	rwlockReleaseWrite(&mutexMap->lock);
+	return entry;
 }
 
-void userMutexUnwaitForAcquire(g_user_mutex mutex, g_tid task)
+void _userMutexRelease(g_physical_address key, g_user_mutex_entry* entry)
 {
-	g_user_mutex_entry* entry = hashmapGet<g_user_mutex, g_user_mutex_entry*>(mutexMap, mutex, nullptr);
-	if(!entry)
+	rwlockAcquireWrite(&mutexMap->lock);
+	if(--entry->references == 0)
 	{
-		logWarn("%! tried to remove waiter for task %i from unknown mutex %i", "mutex", task, mutex);
-		return;
+		hashmapRemove(mutexMap, key);
+		waitQueueDestroy(&entry->waiters);
+		heapFree(entry);
 	}
-
-	waitQueueRemove(&entry->waiters, task);
-}
-
-void _userMutexWakeWaitingTasks(g_user_mutex_entry* entry)
-{
-	waitQueueWake(&entry->waiters);
+	rwlockReleaseWrite(&mutexMap->lock);
 }
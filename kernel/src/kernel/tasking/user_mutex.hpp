@@ -26,60 +26,36 @@
 #include <ghost/tasks/types.h>
 #include <ghost/mutex/types.h>
 
+/**
+ * Tasks that sleep on a user mutex word. Entries only exist while a task is waiting
+ * or waking, they are keyed by the physical address of the word so that words in
+ * shared memory work across processes.
+ */
 struct g_user_mutex_entry
 {
     g_mutex lock;
-    int value;
-
-    bool reentrant;
-    g_tid owner;
+    int references;
 
     g_wait_queue waiters;
 };
 
-typedef uint32_t g_user_mutex_status;
-#define G_USER_MUTEX_STATUS_ACQUIRED      ((g_user_mutex_status) 1)
-#define G_USER_MUTEX_STATUS_TIMEOUT       ((g_user_mutex_status) 2)
-#define G_USER_MUTEX_STATUS_NOT_ACQUIRED  ((g_user_mutex_status) 3)
-
 /**
  * Initializes the mutexes.
  */
 void userMutexInitialize();
 
 /**
- * Creates a new mutex that can then be locked with the other functions.
- */
-g_user_mutex userMutexCreate(bool reentrant);
-
-/**
- * Destroys a mutex.
- */
-void userMutexDestroy(g_user_mutex mutex);
-
-/**
- *
+ * Puts the task to sleep on the word in its address space if the word still contains
+ * the expected value. Returns once the task was woken or the timeout (in milliseconds,
+ * 0 for none) has elapsed.
  */
-g_user_mutex_status userMutexAcquire(g_task* task, g_user_mutex mutex, uint64_t timeout, bool trying);
+g_user_mutex_wait_status userMutexWait(g_task* task, volatile int32_t* word, int32_t expected, uint64_t timeout);
 
 /**
+ * Wakes up to count tasks that sleep on the word.
  *
+ * @return the number of woken tasks
  */
-g_user_mutex_status userMutexTryAcquire(g_task* task, g_user_mutex mutex);
-
-/**
- * Unlocks the mutex and wakes the next waiting task.
- */
-void userMutexRelease(g_user_mutex mutex);
-
-/**
- * Removes the task from a wait queue, for example in case of timeouts.
- */
-void userMutexUnwaitForAcquire(g_user_mutex mutex, g_tid task);
-
-/**
- * Adds the task to the wait queue for the mutex.
- */
-void userMutexWaitForAcquire(g_user_mutex mutex, g_tid task);
+uint32_t userMutexWake(g_task* task, volatile int32_t* word, uint32_t count);
 
 #endif
@@ -22,7 +22,14 @@
 #define __UTILS_HASHMAP__
 
 #include "kernel/memory/heap.hpp"
-#include "kernel/system/mutex.hpp"
+#include "kernel/memory/object_cache.hpp"
+#include "kernel/system/rwlock.hpp"
+
+/**
+ * Entries of all hashmaps that fit into this size share one object cache, larger
+ * entries are allocated on the heap.
+ */
+#define G_HASHMAP_ENTRY_CACHE_SIZE 24
 
 template <typename K, typename V>
 struct g_hashmap_entry
@@ -35,7 +42,10 @@ struct g_hashmap_entry
 template <typename K, typename V>
 struct g_hashmap
 {
-    g_mutex lock;
+    /**
+     * Lookups only read the map, so they can run on all processors at once.
+     */
+    g_rwlock lock;
 
     g_hashmap_entry<K, V>** buckets;
     int bucketCount;
@@ -48,6 +58,44 @@ struct g_hashmap
     bool (*keyEquals)(K k1, K k2);
 };
 
+extern g_object_cache hashmapEntryCache;
+
+template <typename K, typename V>
+g_hashmap_entry<K, V>* hashmapInternalAllocateEntry()
+{
+    if (sizeof(g_hashmap_entry<K, V>) <= G_HASHMAP_ENTRY_CACHE_SIZE)
+        return (g_hashmap_entry<K, V>*)objectCacheAllocate(&hashmapEntryCache);
+    return (g_hashmap_entry<K, V>*)heapAllocate(sizeof(g_hashmap_entry<K, V>));
+}
+
+template <typename K, typename V>
+void hashmapInternalFreeEntry(g_hashmap_entry<K, V>* entry)
+{
+    if (sizeof(g_hashmap_entry<K, V>) <= G_HASHMAP_ENTRY_CACHE_SIZE)
+        objectCacheFree(&hashmapEntryCache, entry);
+    else
+        heapFree(entry);
+}
+
+/**
+ * Looks up the entry for a key. The map lock must be held.
+ */
+template <typename K, typename V>
+g_hashmap_entry<K, V>* hashmapInternalFindEntry(g_hashmap<K, V>* map, K key)
+{
+    int hash = map->keyHash(key);
+    auto* entry = map->buckets[hash % map->bucketCount];
+    while (entry)
+    {
+        if (map->keyEquals(entry->key, key))
+        {
+            break;
+        }
+        entry = entry->next;
+    }
+    return entry;
+}
+
 template <typename K, typename V>
 g_hashmap<K, V>* hashmapInternalCreate(int bucketCount)
 {
@@ -56,7 +104,7 @@ g_hashmap<K, V>* hashmapInternalCreate(int bucketCount)
     map->itemCount = 0;
     map->buckets = (g_hashmap_entry<K, V>**)heapAllocateClear(sizeof(g_hashmap_entry<K, V>*) * bucketCount);
 
-    mutexInitializeGlobal(&map->lock, __func__);
+    rwlockInitialize(&map->lock, __func__);
 
     return map;
 }
@@ -70,7 +118,7 @@ void hashmapDestroy(g_hashmap<K, V>* map)
         while (entry)
         {
             auto next = entry->next;
-            heapFree(entry);
+            hashmapInternalFreeEntry(entry);
             entry = next;
         }
     }
@@ -80,9 +128,9 @@ void hashmapDestroy(g_hashmap<K, V>* map)
 template <typename K, typename V>
 void hashmapPut(g_hashmap<K, V>* map, K key, V value)
 {
-    mutexAcquire(&map->lock);
+    rwlockAcquireWrite(&map->lock);
 
-    auto* entry = hashmapGetEntry(map, key);
+    auto* entry = hashmapInternalFindEntry(map, key);
     if (entry)
     {
         entry->value = value;
@@ -90,7 +138,7 @@ void hashmapPut(g_hashmap<K, V>* map, K key, V value)
     else
     {
         int bucket = map->keyHash(key) % map->bucketCount;
-        auto* newEntry = (g_hashmap_entry<K, V>*)heapAllocate(sizeof(g_hashmap_entry<K, V>));
+        auto* newEntry = hashmapInternalAllocateEntry<K, V>();
         newEntry->key = map->keyCopy(key);
         newEntry->value = value;
         newEntry->next = map->buckets[bucket];
@@ -99,34 +147,23 @@ void hashmapPut(g_hashmap<K, V>* map, K key, V value)
         map->itemCount++;
     }
 
-    mutexRelease(&map->lock);
+    rwlockReleaseWrite(&map->lock);
 }
 
 template <typename K, typename V>
 g_hashmap_entry<K, V>* hashmapGetEntry(g_hashmap<K, V>* map, K key)
 {
-    mutexAcquire(&map->lock);
-
-    int hash = map->keyHash(key);
-    auto* entry = map->buckets[hash % map->bucketCount];
-    while (entry)
-    {
-        if (map->keyEquals(entry->key, key))
-        {
-            break;
-        }
-        entry = entry->next;
-    }
-
-    mutexRelease(&map->lock);
+    rwlockAcquireRead(&map->lock);
+    auto* entry = hashmapInternalFindEntry(map, key);
+    rwlockReleaseRead(&map->lock);
     return entry;
 }
 
 template <typename K, typename V>
 V hashmapGet(g_hashmap<K, V>* map, K key, V def)
 {
-    mutexAcquire(&map->lock);
-    g_hashmap_entry<K, V>* entry = hashmapGetEntry(map, key);
+    rwlockAcquireRead(&map->lock);
+    g_hashmap_entry<K, V>* entry = hashmapInternalFindEntry(map, key);
 
     V value;
     if (entry)
@@ -137,7 +174,7 @@ V hashmapGet(g_hashmap<K, V>* map, K key, V def)
     {
         value = def;
     }
-    mutexRelease(&map->lock);
+    rwlockReleaseRead(&map->lock);
     return value;
 }
 
@@ -150,7 +187,7 @@ uint32_t hashmapSize(g_hashmap<K, V>* map)
 template <typename K, typename V>
 void hashmapRemove(g_hashmap<K, V>* map, K key)
 {
-    mutexAcquire(&map->lock);
+    rwlockAcquireWrite(&map->lock);
 
     int bucket = map->keyHash(key) % map->bucketCount;
     auto* entry = map->buckets[bucket];
@@ -168,7 +205,7 @@ void hashmapRemove(g_hashmap<K, V>* map, K key)
                 map->buckets[bucket] = entry->next;
             }
             map->keyFree(entry->key);
-            heapFree(entry);
+            hashmapInternalFreeEntry(entry);
 
             map->itemCount--;
 
@@ -178,7 +215,7 @@ void hashmapRemove(g_hashmap<K, V>* map, K key)
         entry = entry->next;
     }
 
-    mutexRelease(&map->lock);
+    rwlockReleaseWrite(&map->lock);
 }
 
 template <typename K, typename V>
@@ -196,7 +233,7 @@ struct g_hashmap_iterator
 template <typename K, typename V>
 g_hashmap_iterator<K, V> hashmapIteratorStart(g_hashmap<K, V>* map)
 {
-    mutexAcquire(&map->lock);
+    rwlockAcquireWrite(&map->lock);
 
     g_hashmap_iterator<K, V> iter;
     iter.bucket = 0;
@@ -253,7 +290,7 @@ g_hashmap_entry<K, V>* hashmapIteratorNext(g_hashmap_iterator<K, V>* iter)
 template <typename K, typename V>
 void hashmapIteratorEnd(g_hashmap_iterator<K, V>* iter)
 {
-    mutexRelease(&iter->map->lock);
+    rwlockReleaseWrite(&iter->map->lock);
 }
 
 // Implementation for primitive key types
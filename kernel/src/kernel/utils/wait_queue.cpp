@@ -19,68 +19,162 @@
  * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
 
 #include "kernel/utils/wait_queue.hpp"
-#include "kernel/memory/heap.hpp"
 #include "kernel/tasking/tasking.hpp"
+#include "kernel/tasking/scheduler/scheduler.hpp"
+
+/**
+ * Held while a task is taken out of a queue that is not known to the caller, so
+ * that the queue can't be destroyed in the meantime.
+ */
+static g_mutex waitQueueDetachLock;
+
+void _waitQueueUnlink(g_wait_queue* queue, g_wait_queue_entry* entry);
+void _waitQueueWakeEntry(g_wait_queue_entry* entry, bool* handoff);
+
+void waitQueuesInitialize()
+{
+	mutexInitializeTask(&waitQueueDetachLock, __func__);
+}
 
 void waitQueueInitialize(g_wait_queue* queue)
 {
-	mutexInitializeTask(&queue->lock);
+	mutexInitializeTask(&queue->lock, __func__);
 	queue->head = nullptr;
+	queue->tail = nullptr;
 }
 
-void waitQueueAdd(g_wait_queue* queue, g_tid task)
+void waitQueueAdd(g_wait_queue* queue, g_task* task)
 {
+	g_wait_queue_entry* entry = &task->waitQueueEntry;
+
+	g_wait_queue* previousQueue = entry->queue;
+	if(previousQueue && previousQueue != queue)
+		waitQueueDetach(task);
+
 	mutexAcquire(&queue->lock);
 
-	auto entry = (g_wait_queue_entry*) heapAllocate(sizeof(g_wait_queue_entry));
-	entry->task = task;
-	entry->next = queue->head;
-	queue->head = entry;
+	if(entry->queue != queue)
+	{
+		entry->queue = queue;
+		entry->next = nullptr;
+		entry->previous = queue->tail;
+		if(queue->tail)
+			queue->tail->next = entry;
+		else
+			queue->head = entry;
+		queue->tail = entry;
+	}
 
 	mutexRelease(&queue->lock);
 }
 
-void waitQueueRemove(g_wait_queue* queue, g_tid task)
+void waitQueueRemove(g_wait_queue* queue, g_task* task)
 {
 	mutexAcquire(&queue->lock);
 
-	g_wait_queue_entry* prev = nullptr;
-	g_wait_queue_entry* waiter = queue->head;
-	while(waiter)
+	g_wait_queue_entry* entry = &task->waitQueueEntry;
+	if(entry->queue == queue)
+	{
+		_waitQueueUnlink(queue, entry);
+		entry->queue = nullptr;
+	}
+
+	mutexRelease(&queue->lock);
+}
+
+void waitQueueDetach(g_task* task)
+{
+	g_wait_queue_entry* entry = &task->waitQueueEntry;
+	if(!entry->queue)
+		return;
+
+	mutexAcquire(&waitQueueDetachLock);
+
+	// The queue might have woken the task meanwhile, check again under its lock
+	g_wait_queue* queue = entry->queue;
+	if(queue)
 	{
-		if(waiter->task == task)
+		mutexAcquire(&queue->lock);
+		if(entry->queue == queue)
 		{
-			auto next = waiter->next;
-			if(prev)
-				prev->next = next;
-			else
-				queue->head = next;
-
-			heapFree(waiter);
-			break;
+			_waitQueueUnlink(queue, entry);
+			entry->queue = nullptr;
 		}
-		prev = waiter;
-		waiter = waiter->next;
+		mutexRelease(&queue->lock);
 	}
 
-	mutexRelease(&queue->lock);
+	mutexRelease(&waitQueueDetachLock);
 }
 
-void waitQueueWake(g_wait_queue* queue)
+bool waitQueueWakeOne(g_wait_queue* queue, bool handoff)
 {
 	mutexAcquire(&queue->lock);
 
-	auto waiter = queue->head;
-	while(waiter)
+	g_wait_queue_entry* entry = queue->head;
+	if(entry)
 	{
-		g_task* task = taskingGetById(waiter->task);
-		taskingWake(task);
+		_waitQueueUnlink(queue, entry);
+		_waitQueueWakeEntry(entry, &handoff);
+	}
 
-		auto next = waiter->next;
-		heapFree(waiter);
-		waiter = next;
+	mutexRelease(&queue->lock);
+	return entry != nullptr;
+}
+
+void waitQueueWake(g_wait_queue* queue, bool handoff)
+{
+	mutexAcquire(&queue->lock);
+
+	while(g_wait_queue_entry* entry = queue->head)
+	{
+		_waitQueueUnlink(queue, entry);
+		_waitQueueWakeEntry(entry, &handoff);
 	}
-	queue->head = nullptr;
 
 	mutexRelease(&queue->lock);
 }
+
+void waitQueueDestroy(g_wait_queue* queue)
+{
+	mutexAcquire(&waitQueueDetachLock);
+	waitQueueWake(queue);
+	mutexRelease(&waitQueueDetachLock);
+}
+
+/**
+ * Takes the entry out of the list of the queue. The queue lock must be held.
+ */
+void _waitQueueUnlink(g_wait_queue* queue, g_wait_queue_entry* entry)
+{
+	if(entry->previous)
+		entry->previous->next = entry->next;
+	else
+		queue->head = entry->next;
+
+	if(entry->next)
+		entry->next->previous = entry->previous;
+	else
+		queue->tail = entry->previous;
+
+	entry->next = nullptr;
+	entry->previous = nullptr;
+}
+
+/**
+ * Wakes the task of an unlinked entry. The queue lock must be held; the entry only
+ * stops pointing to the queue once the task was woken, so that a task that is being
+ * destroyed waits in <waitQueueDetach> until this is done.
+ */
+void _waitQueueWakeEntry(g_wait_queue_entry* entry, bool* handoff)
+{
+	g_task* task = entry->task;
+	taskingWake(task);
+
+	if(*handoff && task->assignment == taskingGetLocal())
+	{
+		schedulerPrefer(task);
+		*handoff = false;
+	}
+
+	entry->queue = nullptr;
+}
@@ -25,36 +25,75 @@
 
 #include <ghost/tasks/types.h>
 
+struct g_task;
+struct g_wait_queue;
+
+/**
+ * Link of a task in a wait queue. Each task embeds one entry, so a task can only wait
+ * in one queue at a time.
+ */
 struct g_wait_queue_entry
 {
-    g_tid task;
+    g_task* task;
+    g_wait_queue* queue;
     g_wait_queue_entry* next;
+    g_wait_queue_entry* previous;
 };
 
+/**
+ * Queue of waiting tasks, woken in the order they were added.
+ */
 struct g_wait_queue
 {
-    g_wait_queue_entry* head;
     g_mutex lock;
+    g_wait_queue_entry* head;
+    g_wait_queue_entry* tail;
 };
 
+/**
+ * Initializes the lock that protects moving tasks between wait queues.
+ */
+void waitQueuesInitialize();
+
 /**
  * Initializes a wait-queue.
  */
 void waitQueueInitialize(g_wait_queue* queue);
 
 /**
- * Adds a task entry to the given wait queue.
+ * Appends the task to the wait queue. If the task is still in another queue, it is
+ * removed from there first; if it is already in this queue, nothing happens.
+ */
+void waitQueueAdd(g_wait_queue* queue, g_task* task);
+
+/**
+ * Removes the task from the wait queue if it is in it.
+ */
+void waitQueueRemove(g_wait_queue* queue, g_task* task);
+
+/**
+ * Removes the task from whichever wait queue it is in. Must be done before a task
+ * is destroyed.
+ */
+void waitQueueDetach(g_task* task);
+
+/**
+ * Wakes the task that waits the longest. With handoff, it is preferred on the current
+ * processor once the current task gives up the processor.
+ *
+ * @return whether a task was woken
  */
-void waitQueueAdd(g_wait_queue* queue, g_tid task);
+bool waitQueueWakeOne(g_wait_queue* queue, bool handoff = false);
 
 /**
- * Removes the entry for this task id from the wait queue.
+ * Wakes all tasks in the queue. With handoff, the first woken task that runs on the
+ * current processor is preferred once the current task gives up the processor.
  */
-void waitQueueRemove(g_wait_queue* queue, g_tid task);
+void waitQueueWake(g_wait_queue* queue, bool handoff = false);
 
 /**
- * Wakes all tasks in the queue.
+ * Wakes all tasks in the queue before its memory is freed.
  */
-void waitQueueWake(g_wait_queue* queue);
+void waitQueueDestroy(g_wait_queue* queue);
 
 #endif
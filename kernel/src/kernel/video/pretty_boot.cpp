@@ -53,11 +53,11 @@ void prettyBootEnable(bool clearScreen)
 
 void prettyBootPrintProgressBar(int percent, uint8_t color)
 {
-    double cells = (20.0 / 100.0) * percent;
+    int cells = percent / 5;
     if(cells < 1)
         cells = 1;
 
-    for(int i = 30; i < 30 + (int) cells; i++)
+    for(int i = 30; i < 30 + cells; i++)
         consoleVideoPutChar(i, G_PRETTY_BOOT_PROGRESS_BAR_Y_POS, '\xDC', color);
     for(int i = 30 + cells; i < 50; i++)
         consoleVideoPutChar(i, G_PRETTY_BOOT_PROGRESS_BAR_Y_POS, '\xDC', 0x07);
@@ -43,6 +43,9 @@ typedef int g_kernquery_status;
 #define G_KERNQUERY_TASK_LIST 0x601
 #define G_KERNQUERY_TASK_GET_BY_ID 0x602
 
+#define G_KERNQUERY_LOCK_COUNT 0x700
+#define G_KERNQUERY_LOCK_GET 0x701
+
 /**
  * Used in the {G_KERNQUERY_TASK_COUNT} query to retrieve the number
  * of existing tasks.
@@ -67,6 +70,10 @@ typedef struct
 /**
  * Used in the {G_KERNQUERY_TASK_GET_BY_ID} query to retrieve
  * information about a specific task.
+ *
+ * All times are in nanoseconds. The cpu_time is the sum of the user and kernel time
+ * of the task, process_cpu_time is the same for all tasks of the process including
+ * those that have already exited. The memory used is that of the process image and heap.
  */
 typedef struct
 {
@@ -80,8 +87,49 @@ typedef struct
 
 	g_virtual_address memory_used;
 	uint64_t cpu_time;
+
+	uint64_t user_time;
+	uint64_t kernel_time;
+	uint64_t wait_time;
+	uint64_t process_cpu_time;
 } __attribute__((packed)) g_kernquery_task_get_data;
 
+/**
+ * Used in the {G_KERNQUERY_LOCK_COUNT} query to retrieve the number of kernel
+ * lock locations that have statistics. Fails if the kernel was built without
+ * lock statistics.
+ */
+typedef struct
+{
+	uint32_t count;
+} __attribute__((packed)) g_kernquery_lock_count_data;
+
+/**
+ * Used in the {G_KERNQUERY_LOCK_GET} query to retrieve the statistics of all kernel
+ * locks that were initialized at one location (usually a function name).
+ *
+ * An acquisition is contended if the lock was not free right away; spins is the
+ * number of times contended acquirers had to retry. Wait times are only counted
+ * for contended acquisitions. All times are in nanoseconds.
+ */
+typedef struct
+{
+	uint32_t index;
+	uint8_t found;
+
+	char location[64];
+	uint8_t global;
+
+	uint64_t acquisitions;
+	uint64_t contended;
+	uint64_t spins;
+
+	uint64_t wait_time;
+	uint64_t wait_max;
+	uint64_t hold_time;
+	uint64_t hold_max;
+} __attribute__((packed)) g_kernquery_lock_get_data;
+
 __END_C
 
 #endif
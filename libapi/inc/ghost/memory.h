@@ -49,6 +49,26 @@ __BEGIN_C
 void* g_alloc_mem(g_size size);
 void* g_alloc_mem_p(g_size size, void** out_phys);
 
+/**
+ * Allocates a physically contiguous memory region, for example as a DMA buffer or
+ * descriptor ring. The region is taken from a reserved pool and its size is rounded
+ * up to a power of two pages, up to 4 MiB.
+ *
+ * @param size
+ * 		the size in bytes
+ * @param alignment
+ * 		alignment of the physical address in bytes, at most 4 MiB
+ * @param flags
+ * 		constraints on the physical memory, for example {G_MEM_CONTIGUOUS_BELOW_4G}
+ * @param out_phys
+ * 		is filled with the physical address
+ *
+ * @return a pointer to the allocated memory region, or 0 if failed
+ *
+ * @security-level DRIVER
+ */
+void* g_alloc_mem_contiguous(g_size size, g_size alignment, uint32_t flags, void** out_phys);
+
 /**
  * Shares a memory area with another process.
  *
@@ -48,6 +48,34 @@ typedef struct
 	void* physicalResult;
 }__attribute__((packed)) g_syscall_alloc_mem;
 
+/**
+ * @field size
+ * 		the required size in bytes
+ *
+ * @field alignment
+ * 		alignment of the physical address in bytes
+ *
+ * @field flags
+ * 		constraints on the physical memory, see G_MEM_CONTIGUOUS_*
+ *
+ * @field virtualResult
+ * 		the virtual address of the allocated area, 0 if allocation failed
+ *
+ * @field physicalResult
+ *		the physical address of the first byte of the area
+ *
+ * @security-level DRIVER
+ */
+typedef struct
+{
+	g_size size;
+	g_size alignment;
+	uint32_t flags;
+
+	void* virtualResult;
+	void* physicalResult;
+}__attribute__((packed)) g_syscall_alloc_mem_contiguous;
+
 /**
  * @field memory
  * 		the memory area to share
@@ -29,6 +29,12 @@ __BEGIN_C
  * Page size
  */
 #define G_PAGE_SIZE				0x1000ULL
+
+/**
+ * Flags for contiguous memory allocations
+ */
+#define G_MEM_CONTIGUOUS_NONE			0
+#define G_MEM_CONTIGUOUS_BELOW_4G		1
 #define G_PAGE_ALIGN_MASK		(G_PAGE_SIZE - 1)
 
 /**
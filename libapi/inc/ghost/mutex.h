@@ -26,7 +26,9 @@
 
 __BEGIN_C
 /**
- * Creates an mutex used for locking.
+ * Creates an mutex used for locking. The lock word of the mutex lives in the memory
+ * of the process, so acquiring a free mutex and releasing a mutex that no other task
+ * waits for never enters the kernel.
  *
  * @returns mutex
  * 		the mutex
@@ -82,6 +84,117 @@ void g_mutex_release(g_user_mutex mutex);
  */
 void g_mutex_destroy(g_user_mutex mutex);
 
+/**
+ * Puts the executing task to sleep on a word in process memory, but only if the word
+ * still has the expected value. The task stays asleep until woken with {g_mutex_wake_word}
+ * or until the timeout (in milliseconds, 0 for none) elapses. Waking up does not imply
+ * that the value has changed, callers must check the word again.
+ *
+ * These are the primitives that the mutex is built on and can be used to build other
+ * synchronization mechanisms.
+ *
+ * @param word
+ * 		the word to wait on
+ * @param expected
+ * 		value that the word must have for the task to go to sleep
+ * @param timeout
+ * 		maximum time to wait
+ * @return the status of the wait
+ *
+ * @security-level APPLICATION
+ */
+g_user_mutex_wait_status g_mutex_wait_word(volatile int32_t* word, int32_t expected, uint64_t timeout);
+
+/**
+ * Wakes up to count tasks that wait on the word.
+ *
+ * @param word
+ * 		the word to wake
+ * @param count
+ * 		maximum number of tasks to wake
+ * @return the number of woken tasks
+ *
+ * @security-level APPLICATION
+ */
+uint32_t g_mutex_wake_word(volatile int32_t* word, uint32_t count);
+
+/**
+ * Initializes a condition variable.
+ *
+ * @param condition
+ * 		the condition to initialize
+ *
+ * @security-level APPLICATION
+ */
+void g_condition_initialize(g_user_condition* condition);
+
+/**
+ * Releases the mutex, waits until the condition is signalled and acquires the
+ * mutex again before returning. The mutex must be held by the executing task. As
+ * wake-ups may be spurious, the caller must check its predicate again.
+ *
+ * @param condition
+ * 		the condition to wait on
+ * @param mutex
+ * 		the mutex that protects the predicate
+ * @param timeout
+ * 		maximum time to wait in milliseconds
+ * @return whether the condition was signalled before the timeout elapsed
+ *
+ * @security-level APPLICATION
+ */
+void g_condition_wait(g_user_condition* condition, g_user_mutex mutex);
+g_bool g_condition_wait_to(g_user_condition* condition, g_user_mutex mutex, uint64_t timeout);
+
+/**
+ * Wakes one task (signal) or all tasks (broadcast) that wait on the condition. Does
+ * not enter the kernel if no task waits.
+ *
+ * @param condition
+ * 		the condition to signal
+ *
+ * @security-level APPLICATION
+ */
+void g_condition_signal(g_user_condition* condition);
+void g_condition_broadcast(g_user_condition* condition);
+
+/**
+ * Initializes a counting semaphore with the given number of available units.
+ *
+ * @param semaphore
+ * 		the semaphore to initialize
+ * @param value
+ * 		initial value
+ *
+ * @security-level APPLICATION
+ */
+void g_semaphore_initialize(g_user_semaphore* semaphore, int32_t value);
+
+/**
+ * Takes one unit from the semaphore. If none is available, the executing task sleeps
+ * until one is released or the timeout (in milliseconds) elapses. Trying never sleeps.
+ *
+ * @param semaphore
+ * 		the semaphore to take from
+ * @return whether a unit was taken
+ *
+ * @security-level APPLICATION
+ */
+void g_semaphore_acquire(g_user_semaphore* semaphore);
+g_bool g_semaphore_acquire_to(g_user_semaphore* semaphore, uint64_t timeout);
+g_bool g_semaphore_try_acquire(g_user_semaphore* semaphore);
+
+/**
+ * Puts one unit back into the semaphore and wakes a waiting task. Does not enter
+ * the kernel if no task waits.
+ *
+ * @param semaphore
+ * 		the semaphore to release
+ *
+ * @security-level APPLICATION
+ */
+void g_semaphore_release(g_user_semaphore* semaphore);
+
 
 __END_C
 
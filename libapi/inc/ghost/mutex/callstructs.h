@@ -28,48 +28,31 @@
 __BEGIN_C
 
 /**
- * @field mutex
- * 		the mutex
+ * Puts the task to sleep until the word is woken, but only if it still contains the
+ * expected value. A timeout of 0 waits without limit.
  */
 typedef struct
 {
-	uint8_t reentrant : 1;
-
-	g_user_mutex mutex;
-} __attribute__((packed)) g_syscall_user_mutex_initialize;
-
-/**
- * @field mutex
- * 		the mutex
- */
-typedef struct
-{
-	g_user_mutex mutex;
-} __attribute__((packed)) g_syscall_user_mutex_destroy;
-
-/**
- * @field mutex
- *      the mutex
- * @property isTry
- */
-typedef struct
-{
-	g_user_mutex mutex;
-	uint8_t trying : 1;
+	volatile int32_t* word;
+	int32_t expected;
 	uint64_t timeout;
 
-	uint8_t hasTimedOut : 1;
-	uint8_t wasSet : 1;
-} __attribute__((packed)) g_syscall_user_mutex_acquire;
+	g_user_mutex_wait_status status;
+} __attribute__((packed)) g_syscall_user_mutex_wait;
 
 /**
- * @field mutex
- * 		the mutex
+ * Wakes up to count tasks that wait on the word.
+ *
+ * @field woken
+ * 		number of tasks that were woken
  */
 typedef struct
 {
-	g_user_mutex mutex;
-} __attribute__((packed)) g_syscall_user_mutex_release;
+	volatile int32_t* word;
+	uint32_t count;
+
+	uint32_t woken;
+} __attribute__((packed)) g_syscall_user_mutex_wake;
 
 __END_C
 
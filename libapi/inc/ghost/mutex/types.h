@@ -23,11 +23,64 @@
 
 #include "../common.h"
 #include "../stdint.h"
+#include "../memory/types.h"
 
 __BEGIN_C
 
+/**
+ * Handle of a user mutex. Zero is never a valid handle.
+ */
 typedef uint32_t g_user_mutex;
 
+/**
+ * Lock word that backs a user mutex. It lives in the memory of the process and is
+ * only handled by the kernel when a task must sleep on it or must be woken.
+ *
+ * The state is 0 when the mutex is free, 1 when it is locked and 2 when it is locked
+ * and there may be tasks waiting for it.
+ */
+typedef struct
+{
+	volatile int32_t state;
+	uint8_t reentrant;
+	uint32_t depth;
+	volatile g_address owner;
+
+	/**
+	 * Next unused entry while this entry is not in use.
+	 */
+	g_user_mutex nextFree;
+} g_user_mutex_word;
+
+/**
+ * Condition variable that tasks wait on while releasing a user mutex. Lives in the
+ * memory of the process and must be initialized with {g_condition_initialize}.
+ */
+typedef struct
+{
+	volatile int32_t sequence;
+	volatile int32_t waiters;
+} g_user_condition;
+
+/**
+ * Counting semaphore. Lives in the memory of the process and must be initialized
+ * with {g_semaphore_initialize}.
+ */
+typedef struct
+{
+	volatile int32_t value;
+	volatile int32_t waiters;
+} g_user_semaphore;
+
+/**
+ * Result of waiting on a user mutex word.
+ */
+typedef uint8_t g_user_mutex_wait_status;
+#define G_USER_MUTEX_WAIT_STATUS_WOKEN		((g_user_mutex_wait_status) 0)
+#define G_USER_MUTEX_WAIT_STATUS_CHANGED	((g_user_mutex_wait_status) 1)
+#define G_USER_MUTEX_WAIT_STATUS_TIMEOUT	((g_user_mutex_wait_status) 2)
+#define G_USER_MUTEX_WAIT_STATUS_INVALID	((g_user_mutex_wait_status) 3)
+
 __END_C
 
 #endif
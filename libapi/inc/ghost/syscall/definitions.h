@@ -52,6 +52,7 @@ __BEGIN_C
 #define G_SYSCALL_DUMP							24
 #define G_SYSCALL_GET_NANOSECONDS				25
 #define G_SYSCALL_TASK_AWAIT_BY_NAME		26
+#define G_SYSCALL_TASK_SET_PRIORITY				27
 
 // Memory
 #define G_SYSCALL_LOWER_MEMORY_ALLOCATE			40
@@ -61,12 +62,11 @@ __BEGIN_C
 #define G_SYSCALL_SHARE_MEMORY					44
 #define G_SYSCALL_MAP_MMIO_AREA					45
 #define G_SYSCALL_SBRK							46
+#define G_SYSCALL_ALLOCATE_MEMORY_CONTIGUOUS	47
 
 // Mutex
-#define G_SYSCALL_USER_MUTEX_INITIALIZE 		60
-#define G_SYSCALL_USER_MUTEX_ACQUIRE			61
-#define G_SYSCALL_USER_MUTEX_RELEASE			62
-#define G_SYSCALL_USER_MUTEX_DESTROY			63
+#define G_SYSCALL_USER_MUTEX_WAIT		 		60
+#define G_SYSCALL_USER_MUTEX_WAKE				61
 
 // Messages
 #define G_SYSCALL_MESSAGE_SEND                  70
@@ -227,12 +227,28 @@ void g_sleep(uint64_t ms);
 void g_yield();
 
 /**
- * Yields, trying to cooperatively yield to the given target task.
+ * Yields, handing the rest of the time slice to the given target task if it is
+ * ready to run on the same core.
  *
  * @security-level APPLICATION
  */
 void g_yield_t(g_tid target);
 
+/**
+ * Sets the scheduling priority of a task. Tasks of higher priority are always
+ * chosen before tasks of lower priority; tasks that use up their time without
+ * waiting are temporarily lowered. Applications may only change tasks of their
+ * own process and may not use {G_TASK_PRIORITY_HIGH}.
+ *
+ * @param task id of the task, or G_TID_NONE for the executing task
+ * @param priority one of the {g_task_priority} values
+ *
+ * @return one of the {g_task_set_priority_status} codes
+ *
+ * @security-level APPLICATION
+ */
+g_task_set_priority_status g_task_set_priority(g_tid task, g_task_priority priority);
+
 /**
  * @return local clock time in milliseconds
  *
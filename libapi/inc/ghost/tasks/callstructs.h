@@ -292,6 +292,21 @@ typedef struct
 	g_tid target;
 }__attribute__((packed)) g_syscall_yield;
 
+/**
+ * @field task id of the task, or G_TID_NONE for the executing task
+ * @field priority the priority to set
+ * @field status one of the {g_task_set_priority_status} codes
+ *
+ * @security-level APPLICATION
+ */
+typedef struct
+{
+	g_tid task;
+	g_task_priority priority;
+
+	g_task_set_priority_status status;
+}__attribute__((packed)) g_syscall_task_set_priority;
+
 __END_C
 
 #endif
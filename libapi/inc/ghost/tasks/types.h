@@ -70,6 +70,15 @@ typedef uint8_t g_task_priority;
 
 #define G_TASK_PRIORITY_NORMAL ((g_task_priority) 0)
 #define G_TASK_PRIORITY_IDLE ((g_task_priority) 1)
+#define G_TASK_PRIORITY_HIGH ((g_task_priority) 2)
+#define G_TASK_PRIORITY_LOW ((g_task_priority) 3)
+
+// for <g_task_set_priority>
+typedef uint8_t g_task_set_priority_status;
+#define G_TASK_SET_PRIORITY_STATUS_SUCCESSFUL		((g_task_set_priority_status) 0)
+#define G_TASK_SET_PRIORITY_STATUS_NOT_FOUND		((g_task_set_priority_status) 1)
+#define G_TASK_SET_PRIORITY_STATUS_NOT_PERMITTED	((g_task_set_priority_status) 2)
+#define G_TASK_SET_PRIORITY_STATUS_INVALID			((g_task_set_priority_status) 3)
 
 /**
  * Task setup constants
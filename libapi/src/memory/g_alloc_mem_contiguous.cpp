@@ -0,0 +1,40 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                                                                           *
+ *  Ghost, a micro-kernel based operating system for the x86 architecture    *
+ *  Copyright (C) 2015, Max Schlüssel <lokoxe@gmail.com>                     *
+ *                                                                           *
+ *  This program is free software: you can redistribute it and/or modify     *
+ *  it under the terms of the GNU General Public License as published by     *
+ *  the Free Software Foundation, either version 3 of the License, or        *
+ *  (at your option) any later version.                                      *
+ *                                                                           *
+ *  This program is distributed in the hope that it will be useful,          *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of           *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the            *
+ *  GNU General Public License for more details.                             *
+ *                                                                           *
+ *  You should have received a copy of the GNU General Public License        *
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.    *
+ *                                                                           *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "ghost/syscall.h"
+#include "ghost/memory.h"
+#include "ghost/memory/callstructs.h"
+
+/**
+ * @see header
+ */
+void* g_alloc_mem_contiguous(g_size size, g_size alignment, uint32_t flags, void** out_phys)
+{
+	g_syscall_alloc_mem_contiguous data;
+	data.size = size;
+	data.alignment = alignment;
+	data.flags = flags;
+
+	g_syscall(G_SYSCALL_ALLOCATE_MEMORY_CONTIGUOUS, (g_address) &data);
+
+	if(out_phys)
+		*out_phys = data.physicalResult;
+	return data.virtualResult;
+}
@@ -0,0 +1,103 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                                                                           *
+ *  Ghost, a micro-kernel based operating system for the x86 architecture    *
+ *  Copyright (C) 2015, Max Schlüssel <lokoxe@gmail.com>                     *
+ *                                                                           *
+ *  This program is free software: you can redistribute it and/or modify     *
+ *  it under the terms of the GNU General Public License as published by     *
+ *  the Free Software Foundation, either version 3 of the License, or        *
+ *  (at your option) any later version.                                      *
+ *                                                                           *
+ *  This program is distributed in the hope that it will be useful,          *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of           *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the            *
+ *  GNU General Public License for more details.                             *
+ *                                                                           *
+ *  You should have received a copy of the GNU General Public License        *
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.    *
+ *                                                                           *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "ghost/memory.h"
+#include "ghost/tasks.h"
+#include "__g_mutex_table.hpp"
+
+static g_user_mutex_word* segments[G_MUTEX_TABLE_SEGMENTS];
+static uint32_t segmentCount = 0;
+static g_user_mutex freeHead = 0;
+static volatile int tableLock = 0;
+
+/**
+ * The address of a thread-local variable is unique per thread within the process,
+ * reading it needs no system call.
+ */
+static __thread char threadMarker;
+
+g_address __g_mutex_self()
+{
+	return (g_address) &threadMarker;
+}
+
+g_user_mutex_word* __g_mutex_table_get(g_user_mutex mutex)
+{
+	if(mutex == 0)
+		return nullptr;
+
+	uint32_t index = mutex - 1;
+	uint32_t segment = index / G_MUTEX_TABLE_SEGMENT_ENTRIES;
+	if(segment >= segmentCount)
+		return nullptr;
+	return &segments[segment][index % G_MUTEX_TABLE_SEGMENT_ENTRIES];
+}
+
+void __g_mutex_table_lock()
+{
+	while(!__sync_bool_compare_and_swap(&tableLock, 0, 1))
+		g_yield();
+}
+
+void __g_mutex_table_unlock()
+{
+	__sync_lock_release(&tableLock);
+}
+
+g_user_mutex __g_mutex_table_allocate()
+{
+	__g_mutex_table_lock();
+
+	if(!freeHead && segmentCount < G_MUTEX_TABLE_SEGMENTS)
+	{
+		auto segment = (g_user_mutex_word*) g_alloc_mem(G_PAGE_SIZE);
+		if(segment)
+		{
+			// Chain the new entries into the free list, handles start at 1
+			g_user_mutex first = segmentCount * G_MUTEX_TABLE_SEGMENT_ENTRIES + 1;
+			for(uint32_t i = 0; i < G_MUTEX_TABLE_SEGMENT_ENTRIES; i++)
+				segment[i].nextFree = (i + 1 < G_MUTEX_TABLE_SEGMENT_ENTRIES) ? first + i + 1 : 0;
+
+			segments[segmentCount] = segment;
+			__sync_synchronize();
+			segmentCount++;
+			freeHead = first;
+		}
+	}
+
+	g_user_mutex mutex = freeHead;
+	if(mutex)
+		freeHead = __g_mutex_table_get(mutex)->nextFree;
+
+	__g_mutex_table_unlock();
+	return mutex;
+}
+
+void __g_mutex_table_free(g_user_mutex mutex)
+{
+	g_user_mutex_word* word = __g_mutex_table_get(mutex);
+	if(!word)
+		return;
+
+	__g_mutex_table_lock();
+	word->nextFree = freeHead;
+	freeHead = mutex;
+	__g_mutex_table_unlock();
+}
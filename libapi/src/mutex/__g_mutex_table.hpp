@@ -0,0 +1,55 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                                                                           *
+ *  Ghost, a micro-kernel based operating system for the x86 architecture    *
+ *  Copyright (C) 2015, Max Schlüssel <lokoxe@gmail.com>                     *
+ *                                                                           *
+ *  This program is free software: you can redistribute it and/or modify     *
+ *  it under the terms of the GNU General Public License as published by     *
+ *  the Free Software Foundation, either version 3 of the License, or        *
+ *  (at your option) any later version.                                      *
+ *                                                                           *
+ *  This program is distributed in the hope that it will be useful,          *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of           *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the            *
+ *  GNU General Public License for more details.                             *
+ *                                                                           *
+ *  You should have received a copy of the GNU General Public License        *
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.    *
+ *                                                                           *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef __GHOST_LIBAPI_MUTEX_TABLE__
+#define __GHOST_LIBAPI_MUTEX_TABLE__
+
+#include "ghost/mutex.h"
+
+/**
+ * The lock words of all mutexes of the process are kept in a table that is made of
+ * page-sized segments. Segments are never freed, so words never move and the fast
+ * paths can look them up without taking a lock.
+ */
+#define G_MUTEX_TABLE_SEGMENT_ENTRIES	(G_PAGE_SIZE / sizeof(g_user_mutex_word))
+#define G_MUTEX_TABLE_SEGMENTS			256
+
+/**
+ * Returns the word of the mutex or null if the handle is invalid.
+ */
+g_user_mutex_word* __g_mutex_table_get(g_user_mutex mutex);
+
+/**
+ * Takes an unused word from the table and returns its handle, or 0 if the table
+ * is full.
+ */
+g_user_mutex __g_mutex_table_allocate();
+
+/**
+ * Puts the word back into the table.
+ */
+void __g_mutex_table_free(g_user_mutex mutex);
+
+/**
+ * Identifies the executing thread as owner of reentrant mutexes.
+ */
+g_address __g_mutex_self();
+
+#endif
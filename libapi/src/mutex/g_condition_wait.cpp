@@ -0,0 +1,46 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                                                                           *
+ *  Ghost, a micro-kernel based operating system for the x86 architecture    *
+ *  Copyright (C) 2015, Max Schlüssel <lokoxe@gmail.com>                     *
+ *                                                                           *
+ *  This program is free software: you can redistribute it and/or modify     *
+ *  it under the terms of the GNU General Public License as published by     *
+ *  the Free Software Foundation, either version 3 of the License, or        *
+ *  (at your option) any later version.                                      *
+ *                                                                           *
+ *  This program is distributed in the hope that it will be useful,          *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of           *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the            *
+ *  GNU General Public License for more details.                             *
+ *                                                                           *
+ *  You should have received a copy of the GNU General Public License        *
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.    *
+ *                                                                           *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "ghost/mutex.h"
+
+g_bool __g_condition_wait(g_user_condition* condition, g_user_mutex mutex, uint64_t timeout)
+{
+	// Reading the sequence before releasing the mutex makes sure that a signal given
+	// after the release changes it, so the wait below does not sleep through it
+	int32_t sequence = condition->sequence;
+	__sync_fetch_and_add(&condition->waiters, 1);
+	g_mutex_release(mutex);
+
+	g_user_mutex_wait_status status = g_mutex_wait_word(&condition->sequence, sequence, timeout);
+
+	__sync_fetch_and_sub(&condition->waiters, 1);
+	g_mutex_acquire(mutex);
+	return status != G_USER_MUTEX_WAIT_STATUS_TIMEOUT;
+}
+
+void g_condition_wait(g_user_condition* condition, g_user_mutex mutex)
+{
+	__g_condition_wait(condition, mutex, 0);
+}
+
+g_bool g_condition_wait_to(g_user_condition* condition, g_user_mutex mutex, uint64_t timeout)
+{
+	return __g_condition_wait(condition, mutex, timeout);
+}
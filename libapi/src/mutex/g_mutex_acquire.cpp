@@ -18,21 +18,64 @@
  *                                                                           *
  * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
 
-#include "ghost/syscall.h"
 #include "ghost/mutex.h"
-#include "ghost/mutex/callstructs.h"
+#include "ghost/tasks.h"
+#include "__g_mutex_table.hpp"
 
 g_bool __g_mutex_acquire(g_user_mutex mutex, bool trying, uint64_t timeout)
 {
-	g_syscall_user_mutex_acquire data;
-	data.mutex = mutex;
-	data.trying = trying;
-	data.timeout = timeout;
+	g_user_mutex_word* word = __g_mutex_table_get(mutex);
+	if(!word)
+		return false;
 
-	data.wasSet = false;
-	g_syscall(G_SYSCALL_USER_MUTEX_ACQUIRE, (g_address) &data);
+	g_address self = 0;
+	if(word->reentrant)
+	{
+		self = __g_mutex_self();
+		if(word->owner == self)
+		{
+			word->depth++;
+			return true;
+		}
+	}
 
-	return data.wasSet;
+	// Fast path, the mutex is free
+	int32_t state = __sync_val_compare_and_swap(&word->state, 0, 1);
+	if(state != 0)
+	{
+		if(trying)
+			return false;
+
+		uint64_t deadline = timeout ? g_millis() + timeout : 0;
+
+		// Mark that there are waiters, so the releasing task enters the kernel to wake us
+		if(state != 2)
+			state = __sync_lock_test_and_set(&word->state, 2);
+
+		while(state != 0)
+		{
+			uint64_t remaining = 0;
+			if(timeout)
+			{
+				uint64_t now = g_millis();
+				if(now >= deadline)
+					return false;
+				remaining = deadline - now;
+			}
+
+			if(g_mutex_wait_word(&word->state, 2, remaining) == G_USER_MUTEX_WAIT_STATUS_INVALID)
+				return false;
+
+			state = __sync_lock_test_and_set(&word->state, 2);
+		}
+	}
+
+	if(word->reentrant)
+	{
+		word->owner = self;
+		word->depth = 1;
+	}
+	return true;
 }
 
 void g_mutex_acquire(g_user_mutex mutex)
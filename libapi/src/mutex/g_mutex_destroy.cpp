@@ -18,14 +18,18 @@
  *                                                                           *
  * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
 
-#include "ghost/syscall.h"
 #include "ghost/mutex.h"
-#include "ghost/mutex/callstructs.h"
+#include "__g_mutex_table.hpp"
 
 void g_mutex_destroy(g_user_mutex mutex)
 {
-	g_syscall_user_mutex_destroy data;
-	data.mutex = mutex;
+	g_user_mutex_word* word = __g_mutex_table_get(mutex);
+	if(!word)
+		return;
 
-	g_syscall(G_SYSCALL_USER_MUTEX_DESTROY, (g_address) &data);
+	// Nobody may stay asleep on a word that is reused
+	if(__sync_lock_test_and_set(&word->state, 0) == 2)
+		g_mutex_wake_word(&word->state, UINT32_MAX);
+
+	__g_mutex_table_free(mutex);
 }
@@ -18,9 +18,8 @@
  *                                                                           *
  * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
 
-#include "ghost/syscall.h"
 #include "ghost/mutex.h"
-#include "ghost/mutex/callstructs.h"
+#include "__g_mutex_table.hpp"
 
 g_user_mutex g_mutex_initialize()
 {
@@ -29,10 +28,14 @@ g_user_mutex g_mutex_initialize()
 
 g_user_mutex g_mutex_initialize_r(g_bool reentrant)
 {
-	g_syscall_user_mutex_initialize data;
-	data.reentrant = reentrant;
+	g_user_mutex mutex = __g_mutex_table_allocate();
+	g_user_mutex_word* word = __g_mutex_table_get(mutex);
+	if(!word)
+		return 0;
 
-	g_syscall(G_SYSCALL_USER_MUTEX_INITIALIZE, (g_address) &data);
-
-	return data.mutex;
+	word->state = 0;
+	word->reentrant = reentrant;
+	word->depth = 0;
+	word->owner = 0;
+	return mutex;
 }
@@ -18,15 +18,30 @@
  *                                                                           *
  * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
 
-#include "ghost/syscall.h"
 #include "ghost/mutex.h"
-#include "ghost/mutex/callstructs.h"
-
+#include "__g_mutex_table.hpp"
 
 void g_mutex_release(g_user_mutex mutex)
 {
-	g_syscall_user_mutex_release data;
-	data.mutex = mutex;
+	g_user_mutex_word* word = __g_mutex_table_get(mutex);
+	if(!word)
+		return;
+
+	if(word->reentrant)
+	{
+		if(word->depth > 1)
+		{
+			word->depth--;
+			return;
+		}
+		word->depth = 0;
+		word->owner = 0;
+	}
 
-	g_syscall(G_SYSCALL_USER_MUTEX_RELEASE, (g_address) &data);
+	// Only enter the kernel if a task may be waiting
+	if(__sync_fetch_and_sub(&word->state, 1) != 1)
+	{
+		word->state = 0;
+		g_mutex_wake_word(&word->state, 1);
+	}
 }
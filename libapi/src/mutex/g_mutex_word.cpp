@@ -0,0 +1,47 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                                                                           *
+ *  Ghost, a micro-kernel based operating system for the x86 architecture    *
+ *  Copyright (C) 2015, Max Schlüssel <lokoxe@gmail.com>                     *
+ *                                                                           *
+ *  This program is free software: you can redistribute it and/or modify     *
+ *  it under the terms of the GNU General Public License as published by     *
+ *  the Free Software Foundation, either version 3 of the License, or        *
+ *  (at your option) any later version.                                      *
+ *                                                                           *
+ *  This program is distributed in the hope that it will be useful,          *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of           *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the            *
+ *  GNU General Public License for more details.                             *
+ *                                                                           *
+ *  You should have received a copy of the GNU General Public License        *
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.    *
+ *                                                                           *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "ghost/syscall.h"
+#include "ghost/mutex.h"
+#include "ghost/mutex/callstructs.h"
+
+g_user_mutex_wait_status g_mutex_wait_word(volatile int32_t* word, int32_t expected, uint64_t timeout)
+{
+	g_syscall_user_mutex_wait data;
+	data.word = word;
+	data.expected = expected;
+	data.timeout = timeout;
+
+	g_syscall(G_SYSCALL_USER_MUTEX_WAIT, (g_address) &data);
+
+	return data.status;
+}
+
+uint32_t g_mutex_wake_word(volatile int32_t* word, uint32_t count)
+{
+	g_syscall_user_mutex_wake data;
+	data.word = word;
+	data.count = count;
+	data.woken = 0;
+
+	g_syscall(G_SYSCALL_USER_MUTEX_WAKE, (g_address) &data);
+
+	return data.woken;
+}
@@ -0,0 +1,78 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                                                                           *
+ *  Ghost, a micro-kernel based operating system for the x86 architecture    *
+ *  Copyright (C) 2015, Max Schlüssel <lokoxe@gmail.com>                     *
+ *                                                                           *
+ *  This program is free software: you can redistribute it and/or modify     *
+ *  it under the terms of the GNU General Public License as published by     *
+ *  the Free Software Foundation, either version 3 of the License, or        *
+ *  (at your option) any later version.                                      *
+ *                                                                           *
+ *  This program is distributed in the hope that it will be useful,          *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of           *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the            *
+ *  GNU General Public License for more details.                             *
+ *                                                                           *
+ *  You should have received a copy of the GNU General Public License        *
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.    *
+ *                                                                           *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "ghost/mutex.h"
+#include "ghost/tasks.h"
+
+bool __g_semaphore_try_take(g_user_semaphore* semaphore)
+{
+	int32_t value;
+	while((value = semaphore->value) > 0)
+	{
+		if(__sync_bool_compare_and_swap(&semaphore->value, value, value - 1))
+			return true;
+	}
+	return false;
+}
+
+g_bool __g_semaphore_acquire(g_user_semaphore* semaphore, bool trying, uint64_t timeout)
+{
+	if(__g_semaphore_try_take(semaphore))
+		return true;
+	if(trying)
+		return false;
+
+	uint64_t deadline = timeout ? g_millis() + timeout : 0;
+	while(!__g_semaphore_try_take(semaphore))
+	{
+		uint64_t remaining = 0;
+		if(timeout)
+		{
+			uint64_t now = g_millis();
+			if(now >= deadline)
+				return false;
+			remaining = deadline - now;
+		}
+
+		// Only sleeps if the value is still empty, so a release in between is not lost
+		__sync_fetch_and_add(&semaphore->waiters, 1);
+		g_user_mutex_wait_status status = g_mutex_wait_word(&semaphore->value, 0, remaining);
+		__sync_fetch_and_sub(&semaphore->waiters, 1);
+
+		if(status == G_USER_MUTEX_WAIT_STATUS_INVALID)
+			return false;
+	}
+	return true;
+}
+
+void g_semaphore_acquire(g_user_semaphore* semaphore)
+{
+	__g_semaphore_acquire(semaphore, false, 0);
+}
+
+g_bool g_semaphore_acquire_to(g_user_semaphore* semaphore, uint64_t timeout)
+{
+	return __g_semaphore_acquire(semaphore, false, timeout);
+}
+
+g_bool g_semaphore_try_acquire(g_user_semaphore* semaphore)
+{
+	return __g_semaphore_acquire(semaphore, true, 0);
+}